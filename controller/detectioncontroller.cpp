@@ -25,6 +25,7 @@
 
 #include <QTimer>
 #include <QDebug>
+#include <QPointF>
 #include <QVariant>
 
 DetectionController::DetectionController(QObject *parent)
@@ -42,8 +43,30 @@ DetectionController::DetectionController(QObject *parent)
         m_parseTime = "Parse time: " + QString::number(ms, 'f', 2) + " ms";
         emit parseTimeChanged();
     });
-    connect(m_camera, &CameraModel::detectionsReady,
-            this, &DetectionController::onDetectionsReady);
+    connect(m_camera, &CameraModel::modelReady,
+            this, [this](StartupTimings timings){
+        m_modelReady = true;
+        m_startupTime = "Startup: " + QString::number(timings.totalMs, 'f', 0) + " ms"
+            + " (load " + QString::number(timings.loadMs, 'f', 0)
+            + ", compile " + QString::number(timings.compileMs, 'f', 0)
+            + ", first " + QString::number(timings.firstInferenceMs, 'f', 0) + ")";
+        emit modelReadyChanged();
+        updateInputResolution();
+    });
+    connect(m_camera, &CameraModel::modelLoadFailed,
+            this, [this](const QString &error){
+        m_modelReady = false;
+        m_startupTime = error;
+        emit modelReadyChanged();
+    });
+    connect(m_camera, &CameraModel::candidatesTruncated,
+            this, [this](int count){
+        m_truncatedCandidates = count;
+        emit truncatedCandidatesChanged();
+    });
+    connect(m_camera, &CameraModel::resolutionChanged,
+            this, [this](){ updateInputResolution(); });
+    m_mailbox = m_camera->detectionMailbox();
 }
 
 DetectionController::~DetectionController()
@@ -56,6 +79,11 @@ void DetectionController::handleFrame(const QVideoFrame &frame)
     if(!frame.isValid()) return;
     if(!m_camera) return;
 
+    // Pick up the newest result once per presented frame; results that
+    // arrived in between are coalesced by the mailbox.
+    if(m_mailbox && m_mailbox->update())
+        onDetectionsReady(m_mailbox->readBuffer());
+
     m_camera->processFrameInBatch(frame);
 }
 
@@ -67,11 +95,11 @@ void DetectionController::setVideoSink(QVideoSink* sink)
             this, &DetectionController::handleFrame);
 }
 
-void DetectionController::onDetectionsReady(int batchIndex, const QList<Detection> &detections)
+void DetectionController::onDetectionsReady(const DetectionFrame &frame)
 {
+    const QList<Detection> &detections = frame.detections;
     QVariantList list;
     list.reserve(detections.size());
-    Q_UNUSED(batchIndex);
     m_detections.clear();
     for(const auto& det : detections) {
         QVariantMap map;
@@ -85,3 +113,63 @@ void DetectionController::onDetectionsReady(int batchIndex, const QList<Detectio
     m_detections = list;
     emit detectionsChanged();
 }
+
+void DetectionController::setClassFilter(const QVariantMap &thresholds)
+{
+    m_filter.clearClasses();
+    for(auto it = thresholds.cbegin(); it != thresholds.cend(); ++it) {
+        const int classId = YoloParser::YOLO_CLASSES.indexOf(it.key());
+        if(classId < 0) {
+            qWarning() << "Unknown class in filter:" << it.key();
+            continue;
+        }
+        m_filter.allowClass(classId, it.value().toFloat());
+    }
+    if(m_camera)
+        m_camera->setDetectionFilter(m_filter);
+}
+
+void DetectionController::setRegions(const QVariantList &polygons)
+{
+    m_filter.clearRegions();
+    for(const QVariant &polygon : polygons) {
+        QVector<QPointF> points;
+        for(const QVariant &point : polygon.toList()) {
+            if(point.typeId() == QMetaType::QPointF) {
+                points.append(point.toPointF());
+                continue;
+            }
+            const QVariantMap p = point.toMap();
+            points.append(QPointF(p.value("x").toDouble(), p.value("y").toDouble()));
+        }
+        m_filter.addRegion(points);
+    }
+    if(m_camera)
+        m_camera->setDetectionFilter(m_filter);
+}
+
+void DetectionController::setDecodeLimits(int maxCandidates,
+                                          int maxCandidatesPerClass,
+                                          int maxDetections)
+{
+    DecodeLimits limits;
+    limits.maxCandidates = maxCandidates;
+    limits.maxCandidatesPerClass = maxCandidatesPerClass;
+    limits.maxDetections = maxDetections;
+    if(m_camera)
+        m_camera->setDecodeLimits(limits);
+}
+
+void DetectionController::setTargetFps(double fps)
+{
+    if(m_camera)
+        m_camera->setTargetFps(fps);
+}
+
+void DetectionController::updateInputResolution()
+{
+    const ResolutionStats stats = m_camera->resolutionStats();
+    m_inputResolution = "Input: " + QString::number(stats.inputSize) + " px"
+        + " (" + QString::number(stats.switches()) + " switches)";
+    emit inputResolutionChanged();
+}
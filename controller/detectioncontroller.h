@@ -38,6 +38,10 @@ class DetectionController : public QObject
     Q_PROPERTY(QString inferenceTime READ inferenceTime NOTIFY inferenceTimeChanged)
     Q_PROPERTY(QString parseTime READ parseTime NOTIFY parseTimeChanged)
     Q_PROPERTY(QVariantList detections READ detections NOTIFY detectionsChanged FINAL)
+    Q_PROPERTY(int truncatedCandidates READ truncatedCandidates NOTIFY truncatedCandidatesChanged)
+    Q_PROPERTY(bool modelReady READ modelReady NOTIFY modelReadyChanged)
+    Q_PROPERTY(QString startupTime READ startupTime NOTIFY modelReadyChanged)
+    Q_PROPERTY(QString inputResolution READ inputResolution NOTIFY inputResolutionChanged)
 public:
     explicit DetectionController(QObject *parent = nullptr);
     ~DetectionController();
@@ -45,21 +49,50 @@ public:
     QString inferenceTime() const { return m_inferenceTime; }
     QString parseTime() const { return m_parseTime; }
     QVariantList detections() const { return m_detections; }
+    int truncatedCandidates() const { return m_truncatedCandidates; }
+    bool modelReady() const { return m_modelReady; }
+    QString startupTime() const { return m_startupTime; }
+    QString inputResolution() const { return m_inputResolution; }
+
+    // Restricts detections to the given labels, mapped to their confidence
+    // threshold (0 keeps the default). An empty map allows every class.
+    Q_INVOKABLE void setClassFilter(const QVariantMap &thresholds);
+    // Zones of interest as lists of {x, y} points normalized to the frame.
+    // An empty list covers the whole frame.
+    Q_INVOKABLE void setRegions(const QVariantList &polygons);
+    // Caps on candidates entering NMS and detections leaving it.
+    // Values <= 0 disable the corresponding cap.
+    Q_INVOKABLE void setDecodeLimits(int maxCandidates,
+                                     int maxCandidatesPerClass,
+                                     int maxDetections);
+    // Frame rate the model input resolution is adapted to
+    Q_INVOKABLE void setTargetFps(double fps);
 
 signals:
     void detectionsReady();
     void inferenceTimeChanged();
     void parseTimeChanged();
     void detectionsChanged();
+    void truncatedCandidatesChanged();
+    void modelReadyChanged();
+    void inputResolutionChanged();
 
 private slots:
     void handleFrame(const QVideoFrame& frame);
-    void onDetectionsReady(int batchIndex, const QList<Detection>& detections);
 private:
+    void onDetectionsReady(const DetectionFrame &frame);
+    void updateInputResolution();
+
     CameraModel *m_camera = nullptr;
+    std::shared_ptr<DetectionMailbox> m_mailbox;
     QString m_inferenceTime;
     QString m_parseTime;
     QVariantList m_detections;
+    DetectionFilter m_filter;
+    int m_truncatedCandidates = 0;
+    bool m_modelReady = false;
+    QString m_startupTime;
+    QString m_inputResolution;
 };
 
 #endif // DETECTIONCONTROLLER_H
@@ -17,17 +17,29 @@
 // Project: ObjectRecognition
 // Copyright (C) 2025 José de Jesús Deloya Cruz
 
+#include <QDebug>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 
 #include "controller/detectioncontroller.h"
+#include "model/executor.h"
 #include "version.h"
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
 
+    // Pools are created by the first pipeline stage, so size them before
+    // the controller builds the camera
+    Executor::instance().configure(Executor::defaultConfig());
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, []() {
+        for(const PoolStats &stats : Executor::instance().stats())
+            qInfo() << "Pool" << stats.name << "threads" << stats.threads
+                    << "completed" << stats.completed << "stolen" << stats.stolen
+                    << "utilization" << stats.utilization();
+    });
+
     DetectionController controller;
 
     QQmlApplicationEngine engine;
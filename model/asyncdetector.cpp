@@ -0,0 +1,358 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "asyncdetector.h"
+
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+static double elapsedMs(DetectionClock::time_point start,
+                        DetectionClock::time_point end = DetectionClock::now())
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+struct AsyncDetector::Pending {
+    DetectionRequest request;
+    std::promise<DetectionResult> promise;
+    std::shared_ptr<std::atomic_bool> cancelled;
+    DetectionClock::time_point queuedAt;
+};
+
+/**
+ * @brief Scales an RGB888 image into a letterboxed model input with
+ * bilinear sampling. The letterbox matches YoloParser::letterboxFor, so
+ * the detections come back in the image's own coordinates.
+ * @param rgb, interleaved R, G, B bytes
+ * @param bytesPerLine, row stride of rgb
+ * @param inputSize, side of the model input
+ */
+DetectionRequest DetectionRequest::fromRgb(const uchar *rgb, int width, int height,
+                                           int bytesPerLine, int inputSize)
+{
+    DetectionRequest request;
+    request.letterbox = YoloParser::letterboxFor(width, height, inputSize);
+    const qsizetype plane = qsizetype(inputSize) * inputSize;
+    request.input.assign(3 * plane, 114.f / 255.f);
+    if(!rgb || width <= 0 || height <= 0 || bytesPerLine < width * 3) {
+        qWarning() << "DetectionRequest::fromRgb invalid image"
+                   << width << "x" << height << "stride" << bytesPerLine;
+        return request;
+    }
+
+    const YoloParser::LetterboxInfo &lb = request.letterbox;
+    const int newW = (int)(width * lb.scale);
+    const int newH = (int)(height * lb.scale);
+    for(int y = 0; y < newH; ++y) {
+        const float sy = std::clamp((y + 0.5f) / lb.scale - 0.5f, 0.f, float(height - 1));
+        const int y0 = int(sy);
+        const int y1 = std::min(y0 + 1, height - 1);
+        const float fy = sy - y0;
+        const uchar *row0 = rgb + qsizetype(y0) * bytesPerLine;
+        const uchar *row1 = rgb + qsizetype(y1) * bytesPerLine;
+        float *dst = request.input.data() + qsizetype(y + lb.padY) * inputSize + lb.padX;
+
+        for(int x = 0; x < newW; ++x) {
+            const float sx = std::clamp((x + 0.5f) / lb.scale - 0.5f, 0.f, float(width - 1));
+            const int x0 = int(sx);
+            const int x1 = std::min(x0 + 1, width - 1);
+            const float fx = sx - x0;
+            for(int c = 0; c < 3; ++c) {
+                const float top = row0[x0 * 3 + c] + (row0[x1 * 3 + c] - row0[x0 * 3 + c]) * fx;
+                const float bottom = row1[x0 * 3 + c] + (row1[x1 * 3 + c] - row1[x0 * 3 + c]) * fx;
+                dst[c * plane + x] = (top + (bottom - top) * fy) / 255.f;
+            }
+        }
+    }
+    return request;
+}
+
+void DetectionTicket::cancel() const
+{
+    if(m_cancelled)
+        *m_cancelled = true;
+}
+
+bool DetectionTicket::isCancelled() const
+{
+    return m_cancelled && m_cancelled->load();
+}
+
+AsyncDetector::AsyncDetector(std::shared_ptr<InferenceBackend> backend)
+    : AsyncDetector(std::move(backend), Options())
+{}
+
+AsyncDetector::AsyncDetector(std::shared_ptr<InferenceBackend> backend,
+                             const Options &options)
+    : m_backend(std::move(backend))
+    , m_options(options)
+    , m_tasks(Executor::instance().pool(Executor::PARSE))
+{
+    if(!m_backend) {
+        qWarning() << "AsyncDetector created without a backend, requests are rejected";
+        m_stopping = true;
+        return;
+    }
+
+    m_inputSize = m_backend->inputSize();
+    for(int size : m_backend->supportedBatchSizes()) {
+        if(size > 0)
+            m_batchSizes.append(size);
+    }
+    if(m_batchSizes.isEmpty())
+        m_batchSizes.append(1);
+    std::sort(m_batchSizes.begin(), m_batchSizes.end());
+
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("AsyncDetector");
+    m_thread->start();
+}
+
+AsyncDetector::~AsyncDetector()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeAll();
+    }
+    if(m_thread) {
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    std::deque<std::shared_ptr<Pending>> left;
+    {
+        QMutexLocker locker(&m_mutex);
+        left.swap(m_queue);
+    }
+    for(auto &pending : left) {
+        DetectionResult result;
+        result.status = DetectionResult::Status::Cancelled;
+        result.error = "Detector stopped";
+        finish(*pending, result);
+    }
+    m_tasks.wait();
+}
+
+/**
+ * @brief Queues a request. Never blocks: a full queue, a stopped detector
+ * or a malformed input complete the ticket right away.
+ */
+DetectionTicket AsyncDetector::submit(DetectionRequest request)
+{
+    auto pending = std::make_shared<Pending>();
+    pending->request = std::move(request);
+    pending->cancelled = std::make_shared<std::atomic_bool>(false);
+    pending->queuedAt = DetectionClock::now();
+
+    DetectionTicket ticket;
+    ticket.m_cancelled = pending->cancelled;
+    ticket.result = pending->promise.get_future();
+
+    const qsizetype expected = 3 * qsizetype(m_inputSize) * m_inputSize;
+    if(qsizetype(pending->request.input.size()) != expected) {
+        {
+            QMutexLocker locker(&m_mutex);
+            ++m_stats.submitted;
+        }
+        DetectionResult result;
+        result.error = QString("Input has %1 values, expected %2")
+                           .arg(qsizetype(pending->request.input.size()))
+                           .arg(expected);
+        finish(*pending, result);
+        return ticket;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    ++m_stats.submitted;
+    if(m_stopping || int(m_queue.size()) >= m_options.maxQueue) {
+        locker.unlock();
+        DetectionResult result;
+        result.status = DetectionResult::Status::Rejected;
+        result.error = m_stopping ? "Detector stopped" : "Queue full";
+        finish(*pending, result);
+        return ticket;
+    }
+    m_queue.push_back(std::move(pending));
+    m_wake.wakeAll();
+    return ticket;
+}
+
+AsyncDetector::Stats AsyncDetector::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+/**
+ * @brief Smallest supported batch that holds all queued requests, or the
+ * largest one when none does.
+ */
+int AsyncDetector::batchSizeFor(int queued) const
+{
+    for(int size : m_batchSizes) {
+        if(size >= queued)
+            return size;
+    }
+    return m_batchSizes.last();
+}
+
+void AsyncDetector::run()
+{
+    const int maxBatch = m_batchSizes.last();
+    for(;;) {
+        std::vector<std::shared_ptr<Pending>> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            while(!m_stopping && m_queue.empty())
+                m_wake.wait(&m_mutex);
+            if(m_stopping)
+                break;
+
+            // Give concurrent callers the window to fill the batch
+            const auto windowEnd = m_queue.front()->queuedAt + m_options.batchWindow;
+            while(!m_stopping && int(m_queue.size()) < maxBatch) {
+                const auto now = DetectionClock::now();
+                if(now >= windowEnd)
+                    break;
+                m_wake.wait(&m_mutex, QDeadlineTimer(windowEnd - now, Qt::PreciseTimer));
+            }
+            if(m_stopping)
+                break;
+
+            const int count = std::min(int(m_queue.size()), maxBatch);
+            batch.reserve(count);
+            for(int i = 0; i < count; ++i) {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+        }
+        runBatch(std::move(batch));
+    }
+}
+
+void AsyncDetector::runBatch(std::vector<std::shared_ptr<Pending>> batch)
+{
+    const auto dispatchedAt = DetectionClock::now();
+
+    std::vector<std::shared_ptr<Pending>> live;
+    live.reserve(batch.size());
+    for(auto &pending : batch) {
+        DetectionResult result;
+        if(pending->cancelled->load()) {
+            result.status = DetectionResult::Status::Cancelled;
+        } else if(pending->request.deadline <= dispatchedAt) {
+            result.status = DetectionResult::Status::DeadlineExceeded;
+        } else {
+            live.push_back(std::move(pending));
+            continue;
+        }
+        result.queueMs = elapsedMs(pending->queuedAt, dispatchedAt);
+        finish(*pending, result);
+    }
+    if(live.empty())
+        return;
+
+    const int count = int(live.size());
+    const int batchSize = batchSizeFor(count);
+    const qsizetype plane = 3 * qsizetype(m_inputSize) * m_inputSize;
+    // Unused slots of a padded batch stay zero
+    std::vector<float> input(size_t(batchSize) * plane, 0.f);
+    for(int i = 0; i < count; ++i)
+        std::copy(live[i]->request.input.begin(), live[i]->request.input.end(),
+                  input.begin() + i * plane);
+
+    auto output = std::make_shared<InferenceOutput>();
+    QString error;
+    const auto inferStart = DetectionClock::now();
+    bool ok = m_backend->infer(input.data(), batchSize, *output, &error);
+    const double inferMs = elapsedMs(inferStart);
+
+    if(ok && (output->shape.batch < count
+              || qint64(output->data.size()) < output->shape.extent() * qint64(sizeof(float)))) {
+        ok = false;
+        error = QString("Backend output too small for batch of %1").arg(count);
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_stats.batches;
+        m_stats.batchedRequests += count;
+    }
+
+    for(int i = 0; i < count; ++i) {
+        std::shared_ptr<Pending> pending = live[i];
+        DetectionResult result;
+        result.batchSize = count;
+        result.queueMs = elapsedMs(pending->queuedAt, dispatchedAt);
+        result.inferMs = inferMs;
+        if(!ok) {
+            result.error = error;
+            finish(*pending, result);
+            continue;
+        }
+
+        m_tasks.run([this, output, pending, result, i]() mutable {
+            if(pending->cancelled->load()) {
+                result.status = DetectionResult::Status::Cancelled;
+                finish(*pending, result);
+                return;
+            }
+            const auto parseStart = DetectionClock::now();
+            const float *data = reinterpret_cast<const float*>(output->data.constData());
+            result.detections = YoloParser::parse(data, output->shape, pending->request.letterbox, i,
+                                                  m_options.confThreshold, m_options.iouThreshold,
+                                                  &m_options.filter, m_options.limits);
+            result.parseMs = elapsedMs(parseStart);
+            result.status = DetectionResult::Status::Ok;
+            finish(*pending, result);
+        });
+    }
+}
+
+void AsyncDetector::finish(Pending &pending, DetectionResult result)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        switch(result.status) {
+        case DetectionResult::Status::Ok:
+        case DetectionResult::Status::Failed:
+            ++m_stats.completed;
+            break;
+        case DetectionResult::Status::Cancelled:
+            ++m_stats.cancelled;
+            break;
+        case DetectionResult::Status::DeadlineExceeded:
+            ++m_stats.expired;
+            break;
+        case DetectionResult::Status::Rejected:
+            ++m_stats.rejected;
+            break;
+        }
+    }
+    pending.promise.set_value(std::move(result));
+}
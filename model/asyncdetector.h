@@ -0,0 +1,161 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef ASYNCDETECTOR_H
+#define ASYNCDETECTOR_H
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include "executor.h"
+#include "inferencebackend.h"
+#include "yoloparser.h"
+
+class QThread;
+
+using DetectionClock = std::chrono::steady_clock;
+
+// One image, already letterboxed into the backend's input
+struct DetectionRequest {
+    std::vector<float> input;   // planar RGB, 3 x inputSize x inputSize, in [0, 1]
+    YoloParser::LetterboxInfo letterbox;
+    // Requests still queued at their deadline are not run
+    DetectionClock::time_point deadline = DetectionClock::time_point::max();
+
+    // Letterboxes an interleaved 8-bit RGB image, padding with 114 grey
+    static DetectionRequest fromRgb(const uchar *rgb, int width, int height,
+                                    int bytesPerLine, int inputSize = INPUT_W);
+};
+
+struct DetectionResult {
+    enum class Status {
+        Ok,
+        Cancelled,
+        DeadlineExceeded,
+        Rejected,       // queue full or detector stopping
+        Failed
+    };
+
+    Status status = Status::Failed;
+    QList<Detection> detections;
+    QString error;
+    int batchSize = 0;          // requests sharing the inference call
+    double queueMs = 0.0;
+    double inferMs = 0.0;
+    double parseMs = 0.0;
+};
+
+// Handle of a submitted request
+class DetectionTicket
+{
+public:
+    std::future<DetectionResult> result;
+
+    // Stops the request if it has not been parsed yet; it then completes
+    // with Status::Cancelled
+    void cancel() const;
+    bool isCancelled() const;
+
+private:
+    friend class AsyncDetector;
+    std::shared_ptr<std::atomic_bool> m_cancelled;
+};
+
+/**
+ * @brief Thread-safe, Qt-event-loop free entry point to the detector.
+ * Requests submitted from any thread are queued, grouped into the batch
+ * sizes the backend supports and run on a dispatcher thread; each batch
+ * item is then parsed on the executor's parse pool, so inference of the
+ * next batch overlaps with parsing of the previous one.
+ * The backend must already be loaded and compiled, e.g. by ModelLoader.
+ */
+class AsyncDetector
+{
+public:
+    struct Options {
+        int maxQueue = 64;
+        // How long the first queued request waits for others to fill a batch
+        std::chrono::microseconds batchWindow {2000};
+        float confThreshold = CONF_THRESH;
+        float iouThreshold = IOU_THRESH;
+        DetectionFilter filter;
+        DecodeLimits limits;
+    };
+
+    struct Stats {
+        quint64 submitted = 0;
+        quint64 completed = 0;
+        quint64 cancelled = 0;
+        quint64 expired = 0;
+        quint64 rejected = 0;
+        quint64 batches = 0;
+        quint64 batchedRequests = 0;   // requests run, over all batches
+    };
+
+    explicit AsyncDetector(std::shared_ptr<InferenceBackend> backend,
+                           const Options &options);
+    explicit AsyncDetector(std::shared_ptr<InferenceBackend> backend);
+    // Completes the queued requests with Status::Cancelled and waits for
+    // the in-flight ones
+    ~AsyncDetector();
+
+    AsyncDetector(const AsyncDetector &) = delete;
+    AsyncDetector &operator=(const AsyncDetector &) = delete;
+
+    DetectionTicket submit(DetectionRequest request);
+    Stats stats() const;
+    int inputSize() const { return m_inputSize; }
+
+private:
+    struct Pending;
+
+    std::shared_ptr<InferenceBackend> m_backend;
+    Options m_options;
+    int m_inputSize = INPUT_W;
+    QList<int> m_batchSizes;
+    QThread *m_thread = nullptr;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::deque<std::shared_ptr<Pending>> m_queue;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    void run();
+    int batchSizeFor(int queued) const;
+    void runBatch(std::vector<std::shared_ptr<Pending>> batch);
+    void finish(Pending &pending, DetectionResult result);
+
+    // Last member, so parse tasks finish before anything they use is gone
+    TaskGroup m_tasks;
+};
+
+#endif // ASYNCDETECTOR_H
@@ -31,9 +31,14 @@
 #include <QVector>
 
 #include <atomic>
+#include <memory>
 #include <vector>
 
 #include "yoloparser.h"
+#include "cropstage.h"
+#include "executor.h"
+#include "modelloader.h"
+#include "resolutioncontroller.h"
 
 #ifdef __OBJC__
 #import <CoreML/CoreML.h>
@@ -45,6 +50,7 @@ class MLModel;
 #endif
 
 class QThread;
+class CoreMLBackend;
 
 class CameraModel : public QObject
 {
@@ -56,28 +62,60 @@ public:
 
     QImage getFrame();
 
+    bool isModelReady() const { return model != nullptr; }
+    // Newest detections of this stream; read from a single consumer thread
+    std::shared_ptr<DetectionMailbox> detectionMailbox() const { return mailbox; }
+
     void processFrameInBatch(const QVideoFrame& frame);
     void processFrame(const QVideoFrame& frame );
+    void setDetectionFilter(const DetectionFilter &filter);
+    void setDecodeLimits(const DecodeLimits &limits);
+    // Frame rate the input resolution is adapted to
+    void setTargetFps(double fps);
+    ResolutionStats resolutionStats() const { return resolution->stats(); }
+    // Runs a second-stage model on the crops of every detection, taken
+    // from the full-resolution frames; nullptr turns cropping off
+    void setSecondStage(std::shared_ptr<SecondStageBackend> backend);
+    CropStageStats cropStats() const { return cropStage->stats(); }
 
 private:
     YoloParser *parser = nullptr;
+    std::shared_ptr<DetectionMailbox> mailbox;
     QThread *parseThread = nullptr;
     std::atomic_bool batchInFligt{false};
     std::vector<CVPixelBufferRef> inFlightFrames;
     QVector<YoloParser::LetterboxInfo> letterboxInfo;
     MLModel *model = nullptr;
+    std::shared_ptr<CoreMLBackend> backend;
+    ModelLoader *loader = nullptr;
     std::vector<CVPixelBufferRef> batchFrames;
+    std::vector<float> batchInput;      // NCHW input of the batch being inferred
+    TaskGroup preprocessTasks;          // per-frame NCHW conversion of a batch
+    // Full-resolution frames for the crop stage, parallel to batchFrames
+    // and inFlightFrames; empty while no second stage is set
+    std::shared_ptr<CropStage> cropStage;
+    QList<CropSource> batchSources;
+    QList<CropSource> inFlightSources;
+    ResolutionController *resolution = nullptr;
+    int inputSize = INPUT_W;            // side used by the batch being filled
+    double pendingPreprocessMs = 0.0;   // frames in batchFrames
+    double inFlightPreprocessMs = 0.0;  // frames in inFlightFrames
+    double inFlightInferMs = 0.0;
 
-    void loadModel();
     void processWithCoreML(CVPixelBufferRef pb);
     void processBatch(std::vector<CVPixelBufferRef> frames);
+    // Gives back the in-flight batch when it never reaches the parser
+    void abortBatch();
 signals:
-    void rawBatchReady(QByteArray data, int batchCount, int channels, int boxes, QVector<YoloParser::LetterboxInfo> letterboxInfo);
+    void rawBatchReady(QByteArray data, YoloParser::TensorShape shape, QVector<YoloParser::LetterboxInfo> letterboxInfo, QList<CropSource> sources);
+    void detectionFilterChanged(DetectionFilter filter);
+    void decodeLimitsChanged(DecodeLimits limits);
+    void modelReady(StartupTimings timings);
+    void modelLoadFailed(QString error);
     void inferenceFinished(double ms);
     void parsingFinished(double ms);
-    void detectionsReady(int batchIdx, QList<Detection> detections);
-private slots:
-    void handleDetections(int batchIndex, QList<Detection> detections);
+    void candidatesTruncated(int count);
+    void resolutionChanged(int previousSize, int size, double frameMs);
 };
 
 #endif // CAMERAMODEL_H
@@ -22,6 +22,7 @@
 
 // -*- mode: objc++; -*-
 #import "cameramodel.hpp"
+#import "coremlbackend.hpp"
 #include <QDebug>
 #include <QFile>
 #include <QDir>
@@ -29,15 +30,20 @@
 #include <QVector>
 
 #include <algorithm>
+#include <chrono>
 
 #import <Foundation/Foundation.h>
 #import <CoreVideo/CoreVideo.h>
 #import <CoreImage/CoreImage.h>
 
 CameraModel::CameraModel(QObject *parent)
-    : QObject{parent}, model(nil)
+    : QObject{parent}, model(nil),
+      preprocessTasks(Executor::instance().pool(Executor::PREPROCESS))
 {
-  parser = new YoloParser();
+  mailbox = std::make_shared<DetectionMailbox>();
+  parser = new YoloParser(mailbox);
+  cropStage = std::make_shared<CropStage>();
+  parser->setCropStage(cropStage);
   parseThread = new QThread(this);
   parser->moveToThread(parseThread);
 
@@ -50,18 +56,57 @@ CameraModel::CameraModel(QObject *parent)
           parser, &YoloParser::parseBatch,
           Qt::QueuedConnection);
 
-  connect(parser, &YoloParser::detectionsReady,
-          this, &CameraModel::handleDetections,
+  connect(this, &CameraModel::detectionFilterChanged,
+          parser, &YoloParser::setDetectionFilter,
           Qt::QueuedConnection);
 
+  connect(this, &CameraModel::decodeLimitsChanged,
+          parser, &YoloParser::setDecodeLimits,
+          Qt::QueuedConnection);
+
+  connect(parser, &YoloParser::candidatesTruncated,
+          this, &CameraModel::candidatesTruncated,
+          Qt::QueuedConnection);
+
+  // Input size is picked per batch from the measured stage latencies
+  resolution = new ResolutionController(this);
+  connect(resolution, &ResolutionController::resolutionChanged,
+          this, &CameraModel::resolutionChanged);
+
+  // Load, compile and warm up the model off the GUI thread; frames are
+  // dropped until it is ready.
+  backend = std::make_shared<CoreMLBackend>();
+  loader = new ModelLoader(backend, this);
+  connect(loader, &ModelLoader::ready,
+          this, [this](StartupTimings timings) {
+            model = backend->model();
+            resolution->setSizes(backend->supportedInputSizes());
+            qInfo() << "Input sizes:" << resolution->sizes();
+            emit modelReady(timings);
+          },
+          Qt::QueuedConnection);
+  connect(loader, &ModelLoader::failed,
+          this, &CameraModel::modelLoadFailed,
+          Qt::QueuedConnection);
+  loader->start();
+
   connect(parser, &YoloParser::parsingFinished,
           this, [this](double ms) {
           qWarning() << "Batch parsing finished, releasing in-flight frames";
+          if(!inFlightFrames.empty()) {
+            StageLatency latency;
+            latency.preprocessMs = inFlightPreprocessMs;
+            latency.inferMs = inFlightInferMs;
+            latency.parseMs = ms;
+            latency.frames = int(inFlightFrames.size());
+            resolution->report(latency);
+          }
           @autoreleasepool {
             for(auto& pb : inFlightFrames) {
               if(pb) CVPixelBufferRelease(pb);
             }
             inFlightFrames.clear();
+            inFlightSources.clear();
             batchInFligt = false;
           }
           emit parsingFinished(ms);
@@ -77,6 +122,8 @@ CameraModel::~CameraModel() {
     parseThread->wait();
     parseThread->disconnect();
   }
+  if(loader)
+    loader->wait();
 
 #ifdef __OBJC__
   @autoreleasepool {
@@ -99,65 +146,12 @@ CameraModel::~CameraModel() {
   this->disconnect();
 }
 
-void CameraModel::loadModel()
-{
-#ifdef __OBJC__
-  @autoreleasepool {
-    NSString *name = @"yolo11n";
-    NSString *modelPath = [[NSBundle mainBundle] pathForResource:name ofType:@"mlmodelc"];
-    if(modelPath == nil) {
-      qWarning() << "Could not find " << QString::fromUtf8([name UTF8String]) << "mlmodelc in bundle";
-      model = nullptr;
-      return;
-    }
-    // Log actual path for debugging
-    qInfo() << "Found model bundle at:" << QString::fromUtf8([modelPath UTF8String]);
-    NSURL *url = [NSURL fileURLWithPath:modelPath];
-    if(!url) {
-      qWarning() << "Failed to create URL";
-    }
-
-    NSError *error = nil;
-    MLModelConfiguration *config = [[MLModelConfiguration alloc] init];
-    // The dynamic batch-2 model currently aborts inside the Metal/MPSGraph
-    // specialization path. Force the CPU backend so CoreML returns normal
-    // NSError failures instead of terminating the process in Metal.
-    config.computeUnits = MLComputeUnitsCPUAndNeuralEngine;
-    MLModel* loaded = nil;
-    if([MLModel respondsToSelector:@selector(modelWithContentsOfURL:configuration:error:)]) {
-      loaded = [MLModel modelWithContentsOfURL:url configuration:config error:&error];
-    } else {
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wdeprecated-declarations"
-      loaded = [MLModel modelWithContentsOfURL:url error:&error];
-#pragma clang diagnostic pop
-    }
-
-    if(error) {
-      NSString *desc = error.localizedDescription ?: @"(no description)";
-      qWarning() << "CoreML model load error:" << QString::fromUtf8([desc UTF8String]);
-      model = nil;
-      return;
-    }
-
-    if(!loaded) {
-      qWarning() << "CoreML returned nil model pointer";
-      model = nil;
-      return;
-    }
-    qInfo() << "Compute units:"
-        << (config.computeUnits == MLComputeUnitsAll ? "All (ANE/GPU/CPU)" :
-            config.computeUnits == MLComputeUnitsCPUAndGPU ? "CPU+GPU" :
-            "CPU only");
-    model = loaded;
-
-    // qInfo() << "CoreML model successfully loaded: " << QString::fromUtf8([[model description] UTF8String]);
-    qInfo() << "CoreML model successfully loaded";
-  }
-#endif
-}
-
-static MLMultiArray* pixelBufferToNCHW(CVPixelBufferRef pb)
+/**
+ * @brief Writes a letterboxed BGRA buffer as planar RGB in [0, 1].
+ * @param pb, square input-sized frame.
+ * @param dst, 3 x height x width floats.
+ */
+static bool pixelBufferToNCHW(CVPixelBufferRef pb, float *dst)
 {
     CVPixelBufferLockBaseAddress(pb, kCVPixelBufferLock_ReadOnly);
 
@@ -166,18 +160,10 @@ static MLMultiArray* pixelBufferToNCHW(CVPixelBufferRef pb)
     uint8_t *src  = (uint8_t*)CVPixelBufferGetBaseAddress(pb);
     size_t stride = CVPixelBufferGetBytesPerRow(pb);
 
-    NSArray *shape = @[@1, @3, @(height), @(width)];
-    MLMultiArray *arr = [[MLMultiArray alloc]
-        initWithShape:shape
-              dataType:MLMultiArrayDataTypeFloat32
-                 error:nil];
-
-    float *dst = (float*)arr.dataPointer;
-
     if(!src || !dst) {
-        qWarning() << "Failed to get pixel buffer base address or MLMultiArray data pointer";
+        qWarning() << "Failed to get pixel buffer base address";
         CVPixelBufferUnlockBaseAddress(pb, kCVPixelBufferLock_ReadOnly);
-        return nil;
+        return false;
     }
 
     for (int y = 0; y < height; y++) {
@@ -198,7 +184,7 @@ static MLMultiArray* pixelBufferToNCHW(CVPixelBufferRef pb)
 
     CVPixelBufferUnlockBaseAddress(pb, kCVPixelBufferLock_ReadOnly);
 
-    return arr;
+    return true;
 }
 
 static CVPixelBufferRef letterboxPixelBuffer(CVPixelBufferRef source,
@@ -210,14 +196,11 @@ static CVPixelBufferRef letterboxPixelBuffer(CVPixelBufferRef source,
     size_t srcW = CVPixelBufferGetWidth(source);
     size_t srcH = CVPixelBufferGetHeight(source);
 
-    scale = std::min((float)inputSize / srcW,
-                     (float)inputSize / srcH);
-
-    int newW = (int)(srcW * scale);
-    int newH = (int)(srcH * scale);
-
-    padX = (inputSize - newW) / 2;
-    padY = (inputSize - newH) / 2;
+    const YoloParser::LetterboxInfo info =
+        YoloParser::letterboxFor((int)srcW, (int)srcH, inputSize);
+    scale = info.scale;
+    padX = info.padX;
+    padY = info.padY;
 
     NSDictionary *attrs = @{
         (id)kCVPixelBufferWidthKey: @(inputSize),
@@ -258,11 +241,15 @@ static CVPixelBufferRef letterboxPixelBuffer(CVPixelBufferRef source,
  * @brief Converts from QVideoFrame to CVPixelBufferRef.
  * @param frame, Input frame.
  * @param info, Letterbox info output.
+ * @param inputSize, side of the letterboxed output.
+ * @param source, when set, receives a retained full-resolution copy.
  * @return frame in CVPixelBufferRef format.
  */
 static CVPixelBufferRef QVideoFrame_to_CVPixelBuffer(
     QVideoFrame frame,
-    YoloParser::LetterboxInfo &info
+    YoloParser::LetterboxInfo &info,
+    int inputSize,
+    CVPixelBufferRef *source = nullptr
 )
 {
 #ifdef __OBJC__
@@ -342,12 +329,15 @@ static CVPixelBufferRef QVideoFrame_to_CVPixelBuffer(
         f.unmap();
         float scale;
         int padX, padY;
-        CVPixelBufferRef resizedPB = letterboxPixelBuffer(pb, 640, scale, padX, padY);
+        CVPixelBufferRef resizedPB = letterboxPixelBuffer(pb, inputSize, scale, padX, padY);
         info.scale = scale;
         info.padX = padX;
         info.padY = padY;
         info.origW = width;
         info.origH = height;
+        info.inputSize = inputSize;
+        if (source)
+            *source = CVPixelBufferRetain(pb);
         CVPixelBufferRelease(pb);
         return resizedPB;
     }
@@ -396,12 +386,15 @@ static CVPixelBufferRef QVideoFrame_to_CVPixelBuffer(
         f.unmap();
         float scale;
         int padX, padY;
-        CVPixelBufferRef resizedPB = letterboxPixelBuffer(pb, 640, scale, padX, padY);
+        CVPixelBufferRef resizedPB = letterboxPixelBuffer(pb, inputSize, scale, padX, padY);
         info.scale = scale;
         info.padX = padX;
         info.padY = padY;
         info.origW = width;
         info.origH = height;
+        info.inputSize = inputSize;
+        if (source)
+            *source = CVPixelBufferRetain(pb);
         CVPixelBufferRelease(pb);
         return resizedPB;
     }
@@ -414,86 +407,113 @@ static CVPixelBufferRef QVideoFrame_to_CVPixelBuffer(
   return nullptr;
 }
 
-static MLMultiArray* makeBatch(const std::vector<CVPixelBufferRef> &frames)
+/**
+ * @brief Wraps a full-resolution pixel buffer for the crop stage. Takes
+ * over the caller's reference; the buffer stays locked until the source's
+ * last copy is gone.
+ */
+static CropSource cropSourceFromPixelBuffer(CVPixelBufferRef pb)
 {
-  if(frames.size() != 2) {
-    qWarning() << "makeBatch requires exactly 2 frames";
-    return nil;
+  CropSource source;
+  const OSType type = CVPixelBufferGetPixelFormatType(pb);
+  if (type != kCVPixelFormatType_32BGRA &&
+      type != kCVPixelFormatType_420YpCbCr8BiPlanarVideoRange) {
+    qWarning() << "Unsupported crop source format" << type;
+    CVPixelBufferRelease(pb);
+    return source;
   }
-  if (!frames[0] || !frames[1]) {
-    qWarning() << "Null frame in batch";
-    return nil;
+
+  CVPixelBufferLockBaseAddress(pb, kCVPixelBufferLock_ReadOnly);
+  source.width = (int)CVPixelBufferGetWidth(pb);
+  source.height = (int)CVPixelBufferGetHeight(pb);
+  if (type == kCVPixelFormatType_32BGRA) {
+    source.format = CropSource::Bgra8888;
+    source.planes[0] = (const uchar *)CVPixelBufferGetBaseAddress(pb);
+    source.bytesPerLine[0] = (int)CVPixelBufferGetBytesPerRow(pb);
+  } else {
+    source.format = CropSource::Nv12;
+    for (int plane = 0; plane < 2; ++plane) {
+      source.planes[plane] = (const uchar *)CVPixelBufferGetBaseAddressOfPlane(pb, plane);
+      source.bytesPerLine[plane] = (int)CVPixelBufferGetBytesPerRowOfPlane(pb, plane);
+    }
   }
+  source.owner = std::shared_ptr<const void>(pb, [](const void *p) {
+    CVPixelBufferRef buffer = (CVPixelBufferRef)const_cast<void *>(p);
+    CVPixelBufferUnlockBaseAddress(buffer, kCVPixelBufferLock_ReadOnly);
+    CVPixelBufferRelease(buffer);
+  });
+  return source;
+}
+
+/**
+ * @brief Packs letterboxed frames into one contiguous NCHW batch, the
+ * layout InferenceBackend::infer takes. The input side is taken from the
+ * frames, which must all share it.
+ * @param frames, letterboxed frames.
+ * @param input, resized to the batch and filled.
+ * @param size, receives the input side.
+ * @param tasks, converts the frames in parallel.
+ */
+static bool makeBatch(const std::vector<CVPixelBufferRef> &frames,
+                      std::vector<float> &input, int &size,
+                      TaskGroup &tasks)
+{
+  if(frames.empty()) {
+    qWarning() << "makeBatch requires at least one frame";
+    return false;
+  }
+  for (auto &pb : frames) {
+    if (!pb) {
+      qWarning() << "Null frame in batch";
+      return false;
+    }
+  }
+  size = (int)CVPixelBufferGetWidth(frames[0]);
   for (auto &pb : frames) {
-    if (CVPixelBufferGetWidth(pb) != 640 ||
-      CVPixelBufferGetHeight(pb) != 640) {
+    if (CVPixelBufferGetWidth(pb) != size ||
+      CVPixelBufferGetHeight(pb) != size) {
       qWarning() << "Unexpected pixel buffer size";
-      return nil;
+      return false;
     }
   }
-  NSError* error = nil;
-
-  MLMultiArray* batch = [[MLMultiArray alloc]
-      initWithShape:@[@2, @3, @640, @640]
-            dataType:MLMultiArrayDataTypeFloat32
-               error:&error];
 
-  if (error || !batch) {
-      qWarning() << "Failed to create MLMultiArray for batch";
-      return nil;
+  const size_t imgSize = 3 * size_t(size) * size;
+  input.resize(frames.size() * imgSize);
+  std::atomic_bool ok{true};
+  for(size_t b = 0; b < frames.size(); ++b) {
+    tasks.run([&, b]() {
+      if(!pixelBufferToNCHW(frames[b], input.data() + b * imgSize))
+        ok = false;
+    });
+  }
+  tasks.wait();
+  if(!ok) {
+    qWarning() << "Failed to convert frame to NCHW";
+    return false;
   }
+  return true;
+}
 
-  float* dst = (float*)batch.dataPointer;
-  NSArray* bs = batch.strides;
-  int strideB = [bs[0] intValue];
-  int strideC = [bs[1] intValue];
-  int strideY = [bs[2] intValue];
-  int strideX = [bs[3] intValue];
-
-  const bool contiguous =
-      strideX == 1 &&
-      strideY == 640 &&
-      strideC == 640 * 640 &&
-      strideB == 3 * 640 * 640;
-  const int imgSize = 3 * 640 * 640;
-  for(int b = 0; b<2; ++b) {
-    @autoreleasepool {
-      MLMultiArray* imgArr = pixelBufferToNCHW(frames[b]);
-      if(!imgArr) {
-        qWarning() << "Failed to convert frame to NCHW MLMultiArray";
-        return nil;
-      }
-      float* src = (float*)imgArr.dataPointer;
-      NSArray* is = imgArr.strides;
-      const int icS = [is[1] intValue];
-      const int iyS = [is[2] intValue];
-      const int ixS = [is[3] intValue];
-
-      const bool imgContiguous =
-          ixS == 1 &&
-          iyS == 640 &&
-          icS == 640 * 640;
-
-      if (contiguous && imgContiguous) {
-        memcpy(dst + b * imgSize,
-                src,
-                imgSize * sizeof(float));
-      } else {
-        for(int c=0; c<3; c++)
-        for(int y=0; y<640; y++)
-        for(int x=0; x<640; x++) {
-          int srcIdx = c * 640 * 640 + y * 640 + x;
-          int dstIdx = b * strideB + c * strideC + y * strideY + x * strideX;
-          dst[dstIdx] = src[srcIdx];
-        }
-      }
+/**
+ * @brief Releases the in-flight frames and reports an empty parse, as the
+ * parser would, so the next batch can start.
+ */
+void CameraModel::abortBatch()
+{
+  @autoreleasepool {
+    for (auto &buf : inFlightFrames) {
+      if (buf) CVPixelBufferRelease(buf);
     }
+    inFlightFrames.clear();
+    inFlightSources.clear();
+    batchInFligt = false;
   }
-  return batch;
+  emit parsingFinished(0.0);
 }
 
 /**
- * @brief Process a batch of two frames at time in model.
+ * @brief Process a batch of frames in the model. Runs through the same
+ * backend ModelLoader warmed up, at the input size of the frames.
  */
 void CameraModel::processBatch(std::vector<CVPixelBufferRef> frames)
 {
@@ -501,92 +521,55 @@ void CameraModel::processBatch(std::vector<CVPixelBufferRef> frames)
     @autoreleasepool {
 
         if (!model) {
-          qWarning() << "No ML model loaded, attempting to load";
+          qWarning() << "Model not ready, skipping inference";
+          abortBatch();
+          return;
+        }
+        const int batch = (int)frames.size();
+        if (!backend->supportedBatchSizes().contains(batch)) {
+          qWarning() << "Unsupported batch size" << batch << ", skipping inference";
+          abortBatch();
           return;
         }
-        // Build ML input array
-        MLMultiArray *batch = makeBatch(frames);
-        if (!batch) {
+        int size = 0;
+        if (!makeBatch(frames, batchInput, size, preprocessTasks)) {
           qWarning() << "Batch creation failed, skipping inference";
+          abortBatch();
           return;
         }
-        MLFeatureValue *fv = [MLFeatureValue featureValueWithMultiArray:batch];
-
-        NSDictionary *inputDict = @{ @"image": fv };
-
-        NSError *err = nil;
-        MLDictionaryFeatureProvider *inputs =
-            [[MLDictionaryFeatureProvider alloc] initWithDictionary:inputDict error:&err];
-
-        if (err || !inputs) {
-            qWarning() << "Failed to build feature provider";
-            return;
+        if (size != backend->inputSize() && !backend->setInputSize(size)) {
+          qWarning() << "Backend does not accept input size" << size << ", skipping inference";
+          abortBatch();
+          return;
         }
 
+        InferenceOutput output;
+        QString error;
         auto inferStart = std::chrono::high_resolution_clock::now();
 
-        id<MLFeatureProvider> output =
-            [model predictionFromFeatures:inputs error:&err];
+        const bool ok = backend->infer(batchInput.data(), batch, output, &error);
 
         auto inferEnd = std::chrono::high_resolution_clock::now();
         double inferMs = std::chrono::duration<double, std::milli>(inferEnd - inferStart).count();
+        inFlightInferMs = inferMs;
         emit inferenceFinished(inferMs);
 
-        if (err || !output) {
-            qWarning() << "CoreML prediction failed";
+        if (!ok) {
+            qWarning() << "CoreML prediction failed:" << error;
+            abortBatch();
             return;
         }
 
-        // Get YOLO output
-        MLFeatureValue *rawVal = [output featureValueForName:@"var_1309"];
-        if (!rawVal) {
-            qWarning() << "Missing output var_1309";
-            return;
-        }
-
-        MLMultiArray *raw = rawVal.multiArrayValue;
-        NSArray<NSNumber*> *coremlShape = raw.shape;
-        NSArray<NSNumber*> *coremlStrides = raw.strides;
-        int B = coremlShape[0].intValue;
-        int C = coremlShape[1].intValue;
-        int N = coremlShape[2].intValue;
-
-        qDebug() << "Raw output shape:" << coremlShape;
-        qDebug() << "Raw output strides:" << coremlStrides;
-
-        size_t total = (size_t)B*C*N;
-
-        int strideB = [coremlStrides[0] intValue];
-        int strideC = [coremlStrides[1] intValue];
-        int strideN = [coremlStrides[2] intValue];
-
-        float *src = (float*)raw.dataPointer;
-        BOOL contiguous =
-            strideN == 1 &&
-            strideC == N &&
-            strideB == C * N;
+        const YoloParser::TensorShape &shape = output.shape;
         qWarning() << "CoreML raw shape:"
-           << coremlShape
-           << "B:" << B
-           << "C:" << C
-           << "N:" << N;
-        QByteArray blob;
-        blob.resize(total * sizeof(float));
-        float *copy = reinterpret_cast<float*>(blob.data());;
-        if (contiguous) {
-          memcpy(copy, src, total * sizeof(float));
-        } else {
-          for(int b=0; b<B; b++)
-          for(int c=0; c<C; c++)
-          for(int n=0; n<N; n++) {
-            int srcIdx = b*strideB + c*strideC + n*strideN;
-            int dstIdx = b*C*N + c*N + n;
-            copy[dstIdx] = src[srcIdx];
-          }
-        }
-
-        qWarning() << "Output shape" << coremlShape.count << "Batch:" << coremlShape[0] << "channels" << coremlShape[1] << "boxes" << coremlShape[2];;
-        emit rawBatchReady(blob, B, C, N, letterboxInfo);
+           << "B:" << shape.batch
+           << "C:" << shape.channels
+           << "N:" << shape.boxes
+           << "layout:" << int(shape.layout());
+
+        // The parser decodes [B, C, N], [B, N, C] and padded strides in
+        // place, so the tensor is handed over as-is without re-layout.
+        emit rawBatchReady(output.data, shape, letterboxInfo, inFlightSources);
     }
 #endif
 }
@@ -668,8 +651,7 @@ void CameraModel::processFrameInBatch(const QVideoFrame& frame )
     return;
   }
   if(!model) {
-    qWarning() << "No ML model loaded, attempting to load";
-    loadModel();
+    qWarning() << "Model not ready, dropping frame";
     return;
   }
 
@@ -678,35 +660,49 @@ void CameraModel::processFrameInBatch(const QVideoFrame& frame )
     return;
   }
 
+  // All frames of a batch share one input size; a switch requested by the
+  // resolution controller takes effect at the next batch.
+  if(batchFrames.empty()) {
+    letterboxInfo.clear();
+    batchSources.clear();
+    inputSize = resolution->inputSize();
+  }
+
   YoloParser::LetterboxInfo info;
-  CVPixelBufferRef pb = QVideoFrame_to_CVPixelBuffer(frame, info);
+  CVPixelBufferRef source = nullptr;
+  auto preprocessStart = std::chrono::high_resolution_clock::now();
+  CVPixelBufferRef pb = QVideoFrame_to_CVPixelBuffer(
+      frame, info, inputSize, cropStage->hasBackend() ? &source : nullptr);
+  pendingPreprocessMs += std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - preprocessStart).count();
   if (!pb ||
-    CVPixelBufferGetWidth(pb) != 640 ||
-    CVPixelBufferGetHeight(pb) != 640) {
+    CVPixelBufferGetWidth(pb) != inputSize ||
+    CVPixelBufferGetHeight(pb) != inputSize) {
     qWarning() << "Invalid pixel buffer, skipping batch";
     // if (pb) CVPixelBufferRelease(pb);
-    @autoreleasepool {
-      for (auto &buf : inFlightFrames) {
-          CVPixelBufferRelease(buf);
-      }
-      inFlightFrames.clear();
-      batchInFligt = false;
-    }
-    emit parsingFinished(0.0);
+    if (source) CVPixelBufferRelease(source);
+    abortBatch();
     return;
   }
-  if(batchFrames.empty()) {
-    letterboxInfo.clear();
-  }
 
   letterboxInfo.push_back(info);
   batchFrames.push_back(pb);
+  // Keep sources aligned with the frames once any frame of the batch has one
+  if(source || !batchSources.isEmpty()) {
+    while(batchSources.size() < qsizetype(batchFrames.size()) - 1)
+      batchSources.append(CropSource());
+    batchSources.append(source ? cropSourceFromPixelBuffer(source) : CropSource());
+  }
 
   if(batchFrames.size() == 2) {
     batchInFligt = true;
+    inFlightPreprocessMs = pendingPreprocessMs;
+    pendingPreprocessMs = 0.0;
     @autoreleasepool {
       inFlightFrames.swap(batchFrames);
       batchFrames.clear();
+      inFlightSources.swap(batchSources);
+      batchSources.clear();
       processBatch(inFlightFrames);
     }
   }
@@ -722,13 +718,12 @@ void CameraModel::processFrame(const QVideoFrame& frame )
 {
 #ifdef __OBJC__
   if(!model) {
-    qWarning() << "No ML model loaded, attempting to load";
-    loadModel();
+    qWarning() << "Model not ready, dropping frame";
     return;
   }
 
   YoloParser::LetterboxInfo info;
-  CVPixelBufferRef pb = QVideoFrame_to_CVPixelBuffer(frame, info);
+  CVPixelBufferRef pb = QVideoFrame_to_CVPixelBuffer(frame, info, inputSize);
 
   if(!pb) return;
 
@@ -737,8 +732,38 @@ void CameraModel::processFrame(const QVideoFrame& frame )
 #endif
 }
 
-void CameraModel::handleDetections(int batchIndex, QList<Detection> detections)
+/**
+ * @brief Forwards the stream's detection filter to the parser thread.
+ * @param filter
+ */
+void CameraModel::setDetectionFilter(const DetectionFilter &filter)
+{
+  emit detectionFilterChanged(filter);
+}
+
+/**
+ * @brief Forwards candidate/detection caps to the parser thread.
+ * @param limits
+ */
+void CameraModel::setDecodeLimits(const DecodeLimits &limits)
+{
+  emit decodeLimitsChanged(limits);
+}
+
+/**
+ * @brief Sets the frame rate the input resolution is adapted to.
+ * @param fps
+ */
+void CameraModel::setTargetFps(double fps)
+{
+  resolution->setTargetFps(fps);
+}
+
+/**
+ * @brief Sets the model run on the detection crops of every batch.
+ * @param backend
+ */
+void CameraModel::setSecondStage(std::shared_ptr<SecondStageBackend> backend)
 {
-  qDebug() << "BATCH" << batchIndex << "got" << detections.size() << "detections";
-  emit detectionsReady(batchIndex, detections);
+  cropStage->setBackend(std::move(backend));
 }
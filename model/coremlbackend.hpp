@@ -0,0 +1,69 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef COREMLBACKEND_H
+#define COREMLBACKEND_H
+
+#include <QString>
+
+#include "inferencebackend.h"
+
+#ifdef __OBJC__
+#import <CoreML/CoreML.h>
+#else
+class MLModel;
+class NSURL;
+class MLModelConfiguration;
+#endif
+
+/**
+ * @brief CoreML implementation of InferenceBackend for the bundled
+ * yolo11n.mlmodelc.
+ */
+class CoreMLBackend : public InferenceBackend
+{
+public:
+    explicit CoreMLBackend(const QString &modelName = "yolo11n");
+    ~CoreMLBackend() override;
+
+    bool load(QString *error) override;
+    bool compile(QString *error) override;
+    bool infer(const float *input, int batch,
+               InferenceOutput &output, QString *error) override;
+    QList<int> supportedBatchSizes() const override { return {2}; }
+    int inputSize() const override { return m_inputSize; }
+    // Read from the model's input shape constraint once compiled
+    QList<int> supportedInputSizes() const override;
+    bool setInputSize(int size) override;
+
+    // Compiled model, nil until compile() succeeds
+    MLModel *model() const { return m_model; }
+
+private:
+    QString m_modelName;
+    NSURL *m_url = nullptr;
+    MLModelConfiguration *m_config = nullptr;
+    MLModel *m_model = nullptr;
+    int m_inputSize = INPUT_W;
+};
+
+#endif // COREMLBACKEND_H
@@ -0,0 +1,243 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+// -*- mode: objc++; -*-
+#import "coremlbackend.hpp"
+#import "resolutioncontroller.h"
+#include <QDebug>
+
+#include <algorithm>
+
+#import <Foundation/Foundation.h>
+
+static QString nsErrorString(NSError *error)
+{
+  NSString *desc = error.localizedDescription ?: @"(no description)";
+  return QString::fromUtf8([desc UTF8String]);
+}
+
+CoreMLBackend::CoreMLBackend(const QString &modelName)
+    : m_modelName(modelName)
+{}
+
+CoreMLBackend::~CoreMLBackend()
+{
+  @autoreleasepool {
+    m_model = nil;
+    m_config = nil;
+    m_url = nil;
+  }
+}
+
+/**
+ * @brief Locates the compiled model in the bundle and prepares its configuration.
+ */
+bool CoreMLBackend::load(QString *error)
+{
+  @autoreleasepool {
+    NSString *name = [NSString stringWithUTF8String:m_modelName.toUtf8().constData()];
+    NSString *modelPath = [[NSBundle mainBundle] pathForResource:name ofType:@"mlmodelc"];
+    if(modelPath == nil) {
+      if(error) *error = "Could not find " + m_modelName + ".mlmodelc in bundle";
+      return false;
+    }
+    // Log actual path for debugging
+    qInfo() << "Found model bundle at:" << QString::fromUtf8([modelPath UTF8String]);
+    m_url = [NSURL fileURLWithPath:modelPath];
+    if(!m_url) {
+      if(error) *error = "Failed to create URL";
+      return false;
+    }
+
+    m_config = [[MLModelConfiguration alloc] init];
+    // The dynamic batch-2 model currently aborts inside the Metal/MPSGraph
+    // specialization path. Keep the GPU out and run on the CPU and Neural
+    // Engine, so CoreML returns normal NSError failures instead of
+    // terminating the process in Metal.
+    m_config.computeUnits = MLComputeUnitsCPUAndNeuralEngine;
+    return true;
+  }
+}
+
+/**
+ * @brief Builds the model for the configured compute units.
+ */
+bool CoreMLBackend::compile(QString *error)
+{
+  @autoreleasepool {
+    if(!m_url || !m_config) {
+      if(error) *error = "load() must succeed before compile()";
+      return false;
+    }
+
+    NSError *err = nil;
+    MLModel* loaded = nil;
+    if([MLModel respondsToSelector:@selector(modelWithContentsOfURL:configuration:error:)]) {
+      loaded = [MLModel modelWithContentsOfURL:m_url configuration:m_config error:&err];
+    } else {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+      loaded = [MLModel modelWithContentsOfURL:m_url error:&err];
+#pragma clang diagnostic pop
+    }
+
+    if(err) {
+      if(error) *error = "CoreML model load error: " + nsErrorString(err);
+      return false;
+    }
+
+    if(!loaded) {
+      if(error) *error = "CoreML returned nil model pointer";
+      return false;
+    }
+    qInfo() << "Compute units:"
+        << (m_config.computeUnits == MLComputeUnitsAll ? "All (ANE/GPU/CPU)" :
+            m_config.computeUnits == MLComputeUnitsCPUAndGPU ? "CPU+GPU" :
+            m_config.computeUnits == MLComputeUnitsCPUAndNeuralEngine ? "CPU+ANE" :
+            m_config.computeUnits == MLComputeUnitsCPUOnly ? "CPU only" :
+            "Unknown");
+    m_model = loaded;
+    qInfo() << "CoreML model successfully loaded";
+    return true;
+  }
+}
+
+/**
+ * @brief Square input sides accepted by the model's "image" input. Models
+ * exported with enumerated shapes list them directly; range-shaped models
+ * accept every default controller size inside the range. Fixed-shape
+ * models only accept the current size.
+ */
+QList<int> CoreMLBackend::supportedInputSizes() const
+{
+  QList<int> sizes;
+  @autoreleasepool {
+    MLFeatureDescription *input = m_model
+        ? m_model.modelDescription.inputDescriptionsByName[@"image"] : nil;
+    MLMultiArrayShapeConstraint *constraint = input.multiArrayConstraint.shapeConstraint;
+    if(constraint.type == MLMultiArrayShapeConstraintTypeEnumerated) {
+      for(NSArray<NSNumber*> *shape in constraint.enumeratedShapes) {
+        if(shape.count == 4 && shape[2].intValue == shape[3].intValue)
+          sizes.append(shape[2].intValue);
+      }
+    } else if(constraint.type == MLMultiArrayShapeConstraintTypeRange &&
+              constraint.sizeRangeForDimension.count == 4) {
+      // Ranges are [location, location + length], both ends included
+      const NSRange h = constraint.sizeRangeForDimension[2].rangeValue;
+      const NSRange w = constraint.sizeRangeForDimension[3].rangeValue;
+      auto inRange = [](NSUInteger size, NSRange range) {
+        return size >= range.location && size - range.location <= range.length;
+      };
+      for(int size : ResolutionController::defaultSizes()) {
+        if(inRange(NSUInteger(size), h) && inRange(NSUInteger(size), w))
+          sizes.append(size);
+      }
+    }
+  }
+  if(!sizes.contains(m_inputSize))
+    sizes.append(m_inputSize);
+  std::sort(sizes.begin(), sizes.end());
+  return sizes;
+}
+
+bool CoreMLBackend::setInputSize(int size)
+{
+  if(!supportedInputSizes().contains(size))
+    return false;
+  m_inputSize = size;
+  return true;
+}
+
+/**
+ * @brief Runs one NCHW batch and copies the raw YOLO output.
+ */
+bool CoreMLBackend::infer(const float *input, int batch,
+                          InferenceOutput &output, QString *error)
+{
+  @autoreleasepool {
+    if(!m_model) {
+      if(error) *error = "No ML model loaded";
+      return false;
+    }
+    const int size = inputSize();
+    NSError *err = nil;
+    MLMultiArray *arr = [[MLMultiArray alloc]
+        initWithShape:@[@(batch), @3, @(size), @(size)]
+              dataType:MLMultiArrayDataTypeFloat32
+                 error:&err];
+    if(err || !arr) {
+      if(error) *error = "Failed to create MLMultiArray for batch";
+      return false;
+    }
+
+    float *dst = (float*)arr.dataPointer;
+    NSArray *st = arr.strides;
+    const long strideB = [st[0] longValue];
+    const long strideC = [st[1] longValue];
+    const long strideY = [st[2] longValue];
+    const long strideX = [st[3] longValue];
+    const long plane = long(size) * size;
+    if(strideX == 1 && strideY == size && strideC == plane && strideB == 3 * plane) {
+      memcpy(dst, input, size_t(batch) * 3 * plane * sizeof(float));
+    } else {
+      for(int b = 0; b < batch; ++b)
+      for(int c = 0; c < 3; ++c)
+      for(int y = 0; y < size; ++y) {
+        const float *srcRow = input + (long(b) * 3 + c) * plane + long(y) * size;
+        float *dstRow = dst + b * strideB + c * strideC + y * strideY;
+        for(int x = 0; x < size; ++x)
+          dstRow[x * strideX] = srcRow[x];
+      }
+    }
+
+    MLFeatureValue *fv = [MLFeatureValue featureValueWithMultiArray:arr];
+    MLDictionaryFeatureProvider *inputs =
+        [[MLDictionaryFeatureProvider alloc] initWithDictionary:@{ @"image": fv } error:&err];
+    if(err || !inputs) {
+      if(error) *error = "Failed to build feature provider";
+      return false;
+    }
+
+    id<MLFeatureProvider> result = [m_model predictionFromFeatures:inputs error:&err];
+    if(err || !result) {
+      if(error) *error = "CoreML prediction failed: " + nsErrorString(err);
+      return false;
+    }
+
+    MLMultiArray *raw = [result featureValueForName:@"var_1309"].multiArrayValue;
+    if(!raw || raw.shape.count != 3) {
+      if(error) *error = "Missing output var_1309";
+      return false;
+    }
+
+    const int dims[3] = {
+      raw.shape[0].intValue, raw.shape[1].intValue, raw.shape[2].intValue
+    };
+    const qint64 strides[3] = {
+      raw.strides[0].longLongValue, raw.strides[1].longLongValue, raw.strides[2].longLongValue
+    };
+    output.shape = YoloParser::shapeFromTensor(dims, strides);
+    output.data = QByteArray(reinterpret_cast<const char*>(raw.dataPointer),
+                             output.shape.extent() * sizeof(float));
+    return true;
+  }
+}
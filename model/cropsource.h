@@ -0,0 +1,60 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef CROPSOURCE_H
+#define CROPSOURCE_H
+
+#include <QList>
+#include <QMetaType>
+#include <QtGlobal>
+
+#include <memory>
+
+/**
+ * @brief Full-resolution pixels of one frame, kept for the crop stage.
+ * The view is only valid while owner is alive, so owner must keep the
+ * pixels mapped; it is released once the frame's crops have been taken.
+ */
+struct CropSource {
+    enum Format {
+        Rgb888,     // one plane, interleaved R, G, B
+        Bgra8888,   // one plane, interleaved B, G, R, A
+        Nv12        // Y plane, then interleaved CbCr at half resolution, video range
+    };
+
+    Format format = Rgb888;
+    int width = 0;
+    int height = 0;
+    const uchar *planes[2] = {nullptr, nullptr};
+    int bytesPerLine[2] = {0, 0};
+    std::shared_ptr<const void> owner;
+
+    bool isValid() const {
+        return width > 0 && height > 0 && planes[0] &&
+               (format != Nv12 || planes[1]);
+    }
+};
+
+Q_DECLARE_METATYPE(CropSource)
+Q_DECLARE_METATYPE(QList<CropSource>)
+
+#endif // CROPSOURCE_H
@@ -0,0 +1,346 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "cropstage.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+struct TensorPool::State {
+    QMutex mutex;
+    std::vector<std::unique_ptr<std::vector<float>>> free;
+    int maxFree = 4;
+    quint64 allocations = 0;
+    quint64 reuses = 0;
+};
+
+TensorPool::TensorPool(int maxFree)
+    : m_state(std::make_shared<State>())
+{
+    m_state->maxFree = std::max(0, maxFree);
+}
+
+TensorPool::Buffer TensorPool::acquire(size_t floats)
+{
+    std::unique_ptr<std::vector<float>> buffer;
+    {
+        QMutexLocker lock(&m_state->mutex);
+        // Smallest free buffer that fits, so large ones stay for large batches
+        auto best = m_state->free.end();
+        for(auto it = m_state->free.begin(); it != m_state->free.end(); ++it) {
+            if((*it)->capacity() >= floats &&
+               (best == m_state->free.end() || (*it)->capacity() < (*best)->capacity()))
+                best = it;
+        }
+        if(best != m_state->free.end()) {
+            buffer = std::move(*best);
+            m_state->free.erase(best);
+            ++m_state->reuses;
+        } else {
+            ++m_state->allocations;
+        }
+    }
+    if(!buffer)
+        buffer = std::make_unique<std::vector<float>>();
+    buffer->resize(floats);
+
+    std::weak_ptr<State> pool = m_state;
+    return Buffer(buffer.release(), [pool](std::vector<float> *released) {
+        std::unique_ptr<std::vector<float>> owned(released);
+        if(auto state = pool.lock()) {
+            QMutexLocker lock(&state->mutex);
+            if(int(state->free.size()) < state->maxFree)
+                state->free.push_back(std::move(owned));
+        }
+    });
+}
+
+int TensorPool::freeCount() const
+{
+    QMutexLocker lock(&m_state->mutex);
+    return int(m_state->free.size());
+}
+
+quint64 TensorPool::allocations() const
+{
+    QMutexLocker lock(&m_state->mutex);
+    return m_state->allocations;
+}
+
+quint64 TensorPool::reuses() const
+{
+    QMutexLocker lock(&m_state->mutex);
+    return m_state->reuses;
+}
+
+namespace {
+
+struct Rgb {
+    float r, g, b;
+};
+
+template<CropSource::Format F>
+inline Rgb pixelAt(const CropSource &src, int x, int y)
+{
+    if constexpr (F == CropSource::Rgb888) {
+        const uchar *p = src.planes[0] + qsizetype(y) * src.bytesPerLine[0] + x * 3;
+        return {float(p[0]), float(p[1]), float(p[2])};
+    } else if constexpr (F == CropSource::Bgra8888) {
+        const uchar *p = src.planes[0] + qsizetype(y) * src.bytesPerLine[0] + x * 4;
+        return {float(p[2]), float(p[1]), float(p[0])};
+    } else {
+        // BT.601 video range
+        const float luma = 1.164f * (src.planes[0][qsizetype(y) * src.bytesPerLine[0] + x] - 16.f);
+        const uchar *uv = src.planes[1] + qsizetype(y / 2) * src.bytesPerLine[1] + (x / 2) * 2;
+        const float u = uv[0] - 128.f;
+        const float v = uv[1] - 128.f;
+        return {std::clamp(luma + 1.596f * v, 0.f, 255.f),
+                std::clamp(luma - 0.392f * u - 0.813f * v, 0.f, 255.f),
+                std::clamp(luma + 2.017f * u, 0.f, 255.f)};
+    }
+}
+
+/**
+ * Bilinear resize of rect into one letterboxed crop, the same sampling as
+ * DetectionRequest::fromRgb. dst is already filled with the pad value.
+ */
+template<CropSource::Format F>
+void cropInto(const CropSource &src, const QRect &rect,
+              const YoloParser::LetterboxInfo &lb, int cropSize, float *dst)
+{
+    const qsizetype plane = qsizetype(cropSize) * cropSize;
+    const int newW = (int)(rect.width() * lb.scale);
+    const int newH = (int)(rect.height() * lb.scale);
+    const float maxX = float(rect.x() + rect.width() - 1);
+    const float maxY = float(rect.y() + rect.height() - 1);
+
+    for(int y = 0; y < newH; ++y) {
+        const float sy = std::clamp(rect.y() + (y + 0.5f) / lb.scale - 0.5f,
+                                    float(rect.y()), maxY);
+        const int y0 = int(sy);
+        const int y1 = std::min(y0 + 1, int(maxY));
+        const float fy = sy - y0;
+        float *row = dst + qsizetype(y + lb.padY) * cropSize + lb.padX;
+
+        for(int x = 0; x < newW; ++x) {
+            const float sx = std::clamp(rect.x() + (x + 0.5f) / lb.scale - 0.5f,
+                                        float(rect.x()), maxX);
+            const int x0 = int(sx);
+            const int x1 = std::min(x0 + 1, int(maxX));
+            const float fx = sx - x0;
+
+            const Rgb a = pixelAt<F>(src, x0, y0);
+            const Rgb b = pixelAt<F>(src, x1, y0);
+            const Rgb c = pixelAt<F>(src, x0, y1);
+            const Rgb d = pixelAt<F>(src, x1, y1);
+            auto blend = [fx, fy](float p00, float p10, float p01, float p11) {
+                const float top = p00 + (p10 - p00) * fx;
+                const float bottom = p01 + (p11 - p01) * fx;
+                return (top + (bottom - top) * fy) / 255.f;
+            };
+            row[x] = blend(a.r, b.r, c.r, d.r);
+            row[plane + x] = blend(a.g, b.g, c.g, d.g);
+            row[2 * plane + x] = blend(a.b, b.b, c.b, d.b);
+        }
+    }
+}
+
+} // namespace
+
+CropStage::CropStage()
+    : CropStage(Options())
+{}
+
+CropStage::CropStage(const Options &options)
+    : m_options(options)
+    , m_tasks(Executor::instance().pool(Executor::POSTPROCESS))
+{}
+
+CropStage::~CropStage()
+{
+    m_tasks.wait();
+}
+
+void CropStage::setBackend(std::shared_ptr<SecondStageBackend> backend)
+{
+    QMutexLocker lock(&m_mutex);
+    m_backend = std::move(backend);
+}
+
+bool CropStage::hasBackend() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_backend != nullptr;
+}
+
+/**
+ * @brief Queues one parsed batch: its ROIs are extracted and processed on
+ * the postprocess pool. The task keeps its own references to the sources.
+ * @param sources, full-resolution frames of the batch
+ * @param detections, parser output, one list per frame
+ */
+void CropStage::submit(const QList<CropSource> &sources,
+                       const QList<QList<Detection>> &detections)
+{
+    std::shared_ptr<SecondStageBackend> backend;
+    {
+        QMutexLocker lock(&m_mutex);
+        backend = m_backend;
+    }
+    if(!backend)
+        return;
+
+    m_tasks.run([this, backend, frames = sources, detections]() mutable {
+        const CropBatch batch = extract(frames, detections,
+                                        backend->cropSize(), backend->classes());
+        // The frames are no longer needed; drop them before the task counts
+        // as finished rather than whenever the pool destroys it
+        frames.clear();
+        if(batch.count() == 0)
+            return;
+        QMutexLocker lock(&m_processMutex);
+        backend->process(batch);
+        ++m_batches;
+    });
+}
+
+void CropStage::wait()
+{
+    m_tasks.wait();
+}
+
+/**
+ * @brief Letterboxes every selected ROI of the batch into one pooled
+ * tensor. When there are more than maxCrops, the highest scores are kept;
+ * crops stay in frame and detection order.
+ * @param cropSize, side of each crop
+ * @param classes, classes to crop, empty for all
+ */
+CropBatch CropStage::extract(const QList<CropSource> &sources,
+                             const QList<QList<Detection>> &detections,
+                             int cropSize,
+                             const QList<int> &classes)
+{
+    const auto start = std::chrono::steady_clock::now();
+    CropBatch batch;
+    batch.cropSize = cropSize;
+    if(cropSize <= 0) {
+        qWarning() << "CropStage invalid crop size" << cropSize;
+        return batch;
+    }
+
+    struct Candidate {
+        CropInfo info;
+        float score;
+    };
+    std::vector<Candidate> candidates;
+    quint64 skipped = 0;
+    const int frames = std::min(int(sources.size()), int(detections.size()));
+    for(int f = 0; f < frames; ++f) {
+        const CropSource &source = sources.at(f);
+        if(!source.isValid())
+            continue;
+        const QRect bounds(0, 0, source.width, source.height);
+        const QList<Detection> &frameDetections = detections.at(f);
+        for(int d = 0; d < frameDetections.size(); ++d) {
+            const Detection &det = frameDetections.at(d);
+            if(!classes.isEmpty() && !classes.contains(det.classId))
+                continue;
+            const int mx = int(std::lround(det.rect.width() * m_options.margin));
+            const int my = int(std::lround(det.rect.height() * m_options.margin));
+            const QRect rect = QRect(det.rect.x() - mx, det.rect.y() - my,
+                                     det.rect.width() + 2 * mx,
+                                     det.rect.height() + 2 * my).intersected(bounds);
+            if(rect.width() < m_options.minSide || rect.height() < m_options.minSide) {
+                ++skipped;
+                continue;
+            }
+            Candidate candidate;
+            candidate.info.frame = f;
+            candidate.info.detection = d;
+            candidate.info.classId = det.classId;
+            candidate.info.rect = rect;
+            candidate.info.letterbox = YoloParser::letterboxFor(rect.width(), rect.height(), cropSize);
+            candidate.score = det.score;
+            candidates.push_back(candidate);
+        }
+    }
+
+    const int maxCrops = std::max(0, m_options.maxCrops);
+    if(int(candidates.size()) > maxCrops) {
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+        skipped += candidates.size() - size_t(maxCrops);
+        candidates.resize(size_t(maxCrops));
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const Candidate &a, const Candidate &b) {
+                      return a.info.frame != b.info.frame ? a.info.frame < b.info.frame
+                                                          : a.info.detection < b.info.detection;
+                  });
+    }
+    m_skipped += skipped;
+    if(candidates.empty())
+        return batch;
+
+    const qsizetype cropFloats = 3 * qsizetype(cropSize) * cropSize;
+    batch.tensor = m_pool.acquire(size_t(cropFloats) * candidates.size());
+    std::fill(batch.tensor->begin(), batch.tensor->end(), 114.f / 255.f);
+    batch.crops.reserve(qsizetype(candidates.size()));
+    for(size_t i = 0; i < candidates.size(); ++i) {
+        const CropInfo &info = candidates[i].info;
+        const CropSource &source = sources.at(info.frame);
+        float *dst = batch.tensor->data() + qsizetype(i) * cropFloats;
+        switch(source.format) {
+        case CropSource::Rgb888:
+            cropInto<CropSource::Rgb888>(source, info.rect, info.letterbox, cropSize, dst);
+            break;
+        case CropSource::Bgra8888:
+            cropInto<CropSource::Bgra8888>(source, info.rect, info.letterbox, cropSize, dst);
+            break;
+        case CropSource::Nv12:
+            cropInto<CropSource::Nv12>(source, info.rect, info.letterbox, cropSize, dst);
+            break;
+        }
+        batch.crops.append(info);
+    }
+
+    m_crops += quint64(batch.crops.size());
+    m_extractMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return batch;
+}
+
+CropStageStats CropStage::stats() const
+{
+    CropStageStats stats;
+    stats.batches = m_batches.load();
+    stats.crops = m_crops.load();
+    stats.skipped = m_skipped.load();
+    stats.tensorAllocations = m_pool.allocations();
+    stats.tensorReuses = m_pool.reuses();
+    stats.extractMs = m_extractMs.load();
+    return stats;
+}
@@ -0,0 +1,173 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef CROPSTAGE_H
+#define CROPSTAGE_H
+
+#include <QList>
+#include <QMutex>
+#include <QRect>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "cropsource.h"
+#include "executor.h"
+#include "yoloparser.h"
+
+/**
+ * @brief Recycles float buffers so that steady-state crop batches do not
+ * allocate. Buffers handed out return to the pool when their last
+ * reference goes away, even after the pool itself is destroyed.
+ */
+class TensorPool
+{
+public:
+    using Buffer = std::shared_ptr<std::vector<float>>;
+
+    explicit TensorPool(int maxFree = 4);
+
+    // Buffer of exactly floats elements; contents are unspecified
+    Buffer acquire(size_t floats);
+
+    int freeCount() const;
+    quint64 allocations() const;
+    quint64 reuses() const;
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+};
+
+struct CropInfo {
+    int frame = 0;          // index of the source in the submitted batch
+    int detection = 0;      // index of the detection in that frame
+    int classId = -1;
+    QRect rect;             // source pixels that were cropped
+    // Maps the crop into the tensor: tensor x = padX + (source x - rect.x) * scale
+    YoloParser::LetterboxInfo letterbox;
+};
+
+/**
+ * @brief Every ROI of one parsed batch, letterboxed into one contiguous
+ * planar RGB tensor of count() x 3 x cropSize x cropSize, values in [0, 1].
+ * Copying the batch shares the tensor.
+ */
+struct CropBatch {
+    int cropSize = 0;
+    QList<CropInfo> crops;
+    TensorPool::Buffer tensor;
+
+    int count() const { return int(crops.size()); }
+    const float *data() const { return tensor ? tensor->data() : nullptr; }
+    const float *crop(int index) const {
+        return data() + qsizetype(index) * 3 * cropSize * cropSize;
+    }
+};
+
+/**
+ * @brief Second-stage model run on the detector's crops (plates, faces,
+ * PPE...). process() is called on a postprocess worker, one batch at a
+ * time per crop stage.
+ */
+class SecondStageBackend
+{
+public:
+    virtual ~SecondStageBackend() = default;
+
+    // Side of the square crops the model expects
+    virtual int cropSize() const = 0;
+    // Classes worth a second look; empty means every class
+    virtual QList<int> classes() const { return {}; }
+    virtual void process(const CropBatch &batch) = 0;
+};
+
+struct CropStageStats {
+    quint64 batches = 0;    // handed to the backend
+    quint64 crops = 0;
+    quint64 skipped = 0;    // too small or over maxCrops
+    quint64 tensorAllocations = 0;
+    quint64 tensorReuses = 0;
+    double extractMs = 0.0; // last batch
+};
+
+/**
+ * @brief Cuts the detections of a parsed batch out of the full-resolution
+ * frames and hands them to a SecondStageBackend. All ROIs of a batch are
+ * extracted in one pass into one pooled tensor, with the same letterbox
+ * as the detector input, so the frames are never decoded twice.
+ * The sources are referenced until their crops are written.
+ */
+class CropStage
+{
+public:
+    struct Options {
+        int maxCrops = 32;      // per batch, highest-scoring first
+        float margin = 0.f;     // context added on each side, fraction of the box
+        int minSide = 4;        // boxes smaller than this in source pixels are skipped
+    };
+
+    CropStage();
+    explicit CropStage(const Options &options);
+    // Waits for the batches still being cropped
+    ~CropStage();
+
+    CropStage(const CropStage &) = delete;
+    CropStage &operator=(const CropStage &) = delete;
+
+    // Thread-safe; nullptr disables the stage
+    void setBackend(std::shared_ptr<SecondStageBackend> backend);
+    bool hasBackend() const;
+
+    // Crops and processes on the postprocess pool. detections[i] belongs to
+    // sources[i]; missing or invalid sources are skipped.
+    void submit(const QList<CropSource> &sources,
+                const QList<QList<Detection>> &detections);
+    void wait();
+
+    // Synchronous extraction into a pooled tensor, used by submit()
+    CropBatch extract(const QList<CropSource> &sources,
+                      const QList<QList<Detection>> &detections,
+                      int cropSize,
+                      const QList<int> &classes = {});
+
+    CropStageStats stats() const;
+
+private:
+    Options m_options;
+    TensorPool m_pool;
+    mutable QMutex m_mutex;
+    std::shared_ptr<SecondStageBackend> m_backend;
+    std::atomic<quint64> m_batches{0};
+    std::atomic<quint64> m_crops{0};
+    std::atomic<quint64> m_skipped{0};
+    std::atomic<double> m_extractMs{0.0};
+    // Serializes process() calls of one stage
+    QMutex m_processMutex;
+
+    // Last member, so in-flight batches finish before anything they use
+    // is destroyed
+    TaskGroup m_tasks;
+};
+
+#endif // CROPSTAGE_H
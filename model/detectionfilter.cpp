@@ -0,0 +1,108 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "detectionfilter.h"
+
+#include <algorithm>
+
+void DetectionFilter::allowClass(int classId, float confThreshold)
+{
+    if(classId < 0) return;
+    const qsizetype existing = m_classes.indexOf(classId);
+    if(existing >= 0) {
+        m_thresholds[existing] = confThreshold;
+        return;
+    }
+    m_classes.append(classId);
+    m_thresholds.append(confThreshold);
+}
+
+void DetectionFilter::clearClasses()
+{
+    m_classes.clear();
+    m_thresholds.clear();
+}
+
+/**
+ * @brief Returns the threshold of the index-th allowed class.
+ * @param index, position in allowedClasses()
+ * @param fallback, threshold used when the class has none of its own
+ * @return
+ */
+float DetectionFilter::threshold(int index, float fallback) const
+{
+    const float t = m_thresholds.value(index, 0.f);
+    return t > 0.f ? t : fallback;
+}
+
+/**
+ * @brief Rasterizes a polygon into the region mask.
+ * @param polygon, vertices in normalized frame coordinates
+ */
+void DetectionFilter::addRegion(const QVector<QPointF> &polygon)
+{
+    if(polygon.size() < 3) return;
+    if(m_mask.empty())
+        m_mask.assign(size_t(MASK_SIZE) * MASK_SIZE, 0);
+
+    for(int y = 0; y < MASK_SIZE; ++y) {
+        const double cy = (y + 0.5) / MASK_SIZE;
+        for(int x = 0; x < MASK_SIZE; ++x) {
+            const double cx = (x + 0.5) / MASK_SIZE;
+            if(pointInPolygon(polygon, cx, cy))
+                m_mask[size_t(y) * MASK_SIZE + x] = 1;
+        }
+    }
+}
+
+void DetectionFilter::clearRegions()
+{
+    m_mask.clear();
+}
+
+bool DetectionFilter::containsNormalized(float nx, float ny) const
+{
+    if(m_mask.empty()) return true;
+    if(nx < 0.f || ny < 0.f || nx >= 1.f || ny >= 1.f) return false;
+    const int x = std::min(int(nx * MASK_SIZE), MASK_SIZE - 1);
+    const int y = std::min(int(ny * MASK_SIZE), MASK_SIZE - 1);
+    return m_mask[size_t(y) * MASK_SIZE + x] != 0;
+}
+
+/**
+ * @brief Even-odd point in polygon test.
+ */
+bool DetectionFilter::pointInPolygon(const QVector<QPointF> &polygon, double x, double y)
+{
+    bool inside = false;
+    const qsizetype n = polygon.size();
+    for(qsizetype i = 0, j = n - 1; i < n; j = i++) {
+        const QPointF &a = polygon.at(i);
+        const QPointF &b = polygon.at(j);
+        if((a.y() > y) != (b.y() > y)) {
+            const double xCross = (b.x() - a.x()) * (y - a.y()) / (b.y() - a.y()) + a.x();
+            if(x < xCross)
+                inside = !inside;
+        }
+    }
+    return inside;
+}
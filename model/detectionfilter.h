@@ -0,0 +1,71 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef DETECTIONFILTER_H
+#define DETECTIONFILTER_H
+
+#include <QList>
+#include <QPointF>
+#include <QVector>
+#include <QMetaType>
+
+#include <vector>
+
+/**
+ * @brief Per-stream detection filter pushed down into tensor decoding.
+ * A class allow-list restricts which class rows the decoder reads, each with
+ * its own confidence threshold. Regions are polygons in normalized [0, 1]
+ * coordinates of the original frame, rasterized into a coarse mask that is
+ * tested against box centers before NMS.
+ */
+class DetectionFilter
+{
+public:
+    static constexpr int MASK_SIZE = 128;
+
+    // Allows classId with its own threshold. A threshold <= 0 uses the
+    // parser's confidence threshold.
+    void allowClass(int classId, float confThreshold = 0.f);
+    void clearClasses();
+    bool hasClassFilter() const { return !m_classes.isEmpty(); }
+    const QVector<int>& allowedClasses() const { return m_classes; }
+    float threshold(int index, float fallback) const;
+
+    // Adds a polygon zone of interest, in normalized frame coordinates
+    void addRegion(const QVector<QPointF> &polygon);
+    void clearRegions();
+    bool hasRegions() const { return !m_mask.empty(); }
+    bool containsNormalized(float nx, float ny) const;
+
+    bool isEmpty() const { return !hasClassFilter() && !hasRegions(); }
+
+private:
+    QVector<int> m_classes;
+    QVector<float> m_thresholds;
+    std::vector<quint8> m_mask;
+
+    static bool pointInPolygon(const QVector<QPointF> &polygon, double x, double y);
+};
+
+Q_DECLARE_METATYPE(DetectionFilter)
+
+#endif // DETECTIONFILTER_H
@@ -0,0 +1,92 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef DETECTIONMAILBOX_H
+#define DETECTIONMAILBOX_H
+
+#include <QList>
+#include <QtGlobal>
+
+#include <array>
+#include <atomic>
+
+#include "../helpers/detection.h"
+
+/**
+ * @brief Lock-free single-producer / single-consumer triple buffer.
+ * The writer fills writeBuffer() and publish()es it; the reader calls
+ * update() and, when it returns true, reads the newest value from
+ * readBuffer(). Values published while the reader was busy are coalesced:
+ * only the latest one is ever seen and nothing queues up.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+    // Writer side
+    T& writeBuffer() { return m_slots[m_back]; }
+
+    void publish()
+    {
+        const int prev = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel);
+        if(prev & FRESH)
+            m_coalesced.fetch_add(1, std::memory_order_relaxed);
+        m_back = prev & INDEX;
+    }
+
+    // Reader side
+    bool update()
+    {
+        if(!(m_middle.load(std::memory_order_acquire) & FRESH))
+            return false;
+        const int prev = m_middle.exchange(m_front, std::memory_order_acq_rel);
+        m_front = prev & INDEX;
+        return true;
+    }
+
+    const T& readBuffer() const { return m_slots[m_front]; }
+
+    // Publications overwritten before the reader took them
+    quint64 coalescedCount() const { return m_coalesced.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr int INDEX = 0x3;
+    static constexpr int FRESH = 0x4;
+
+    std::array<T, 3> m_slots;
+    int m_back = 0;                     // owned by the writer
+    int m_front = 1;                    // owned by the reader
+    std::atomic<int> m_middle{2};       // exchanged between both
+    std::atomic<quint64> m_coalesced{0};
+};
+
+// Latest parse result of one stream
+struct DetectionFrame {
+    quint64 sequence = 0;
+    int batchIndex = 0;                 // newest item of the parsed batch
+    double parseMs = 0.0;
+    QList<Detection> detections;
+};
+
+using DetectionMailbox = TripleBuffer<DetectionFrame>;
+
+#endif // DETECTIONMAILBOX_H
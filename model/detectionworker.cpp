@@ -0,0 +1,396 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "detectionworker.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static float elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void writeSharedFrameHeader(SharedRing::Slot &slot, const SharedFrameHeader &header)
+{
+    std::memcpy(slot.data, &header, sizeof(header));
+}
+
+/**
+ * @brief Decodes a result slot back into detections.
+ * @param slot, slot acquired from the result ring
+ * @param header, receives the result header when not null
+ */
+QList<Detection> readSharedDetections(const SharedRing::Slot &slot, SharedResultHeader *header)
+{
+    SharedResultHeader result;
+    if(!slot.isValid() || slot.size < sizeof(result))
+        return {};
+    std::memcpy(&result, slot.data, sizeof(result));
+    if(header)
+        *header = result;
+
+    const qint32 fits = qint32((slot.size - sizeof(result)) / sizeof(SharedDetection));
+    const qint32 count = std::clamp(result.count, 0, fits);
+    QList<Detection> detections;
+    detections.reserve(count);
+    const uchar *src = slot.data + sizeof(result);
+    for(qint32 i = 0; i < count; ++i) {
+        SharedDetection shared;
+        std::memcpy(&shared, src + i * sizeof(shared), sizeof(shared));
+        Detection det;
+        det.classId = shared.classId;
+        det.score = shared.score;
+        det.rect = QRect(shared.x, shared.y, shared.width, shared.height);
+        det.label = YoloParser::YOLO_CLASSES.value(shared.classId);
+        detections.append(det);
+    }
+    return detections;
+}
+
+DetectionWorker::DetectionWorker(std::shared_ptr<InferenceBackend> backend,
+                                 const Config &config)
+    : m_backend(std::move(backend))
+    , m_config(config)
+{}
+
+int DetectionWorker::run()
+{
+    QString error;
+    m_frames = SharedRing::open(m_config.frameRing, &error);
+    if(m_frames)
+        m_results = SharedRing::open(m_config.resultRing, &error);
+    if(!m_frames || !m_results) {
+        qWarning() << "DetectionWorker could not open rings:" << error;
+        return -1;
+    }
+    if(!m_backend) {
+        qWarning() << "DetectionWorker has no backend";
+        return -1;
+    }
+    if(!m_backend->load(&error) || !m_backend->compile(&error)) {
+        qWarning() << "DetectionWorker backend failed:" << error;
+        return -1;
+    }
+    if(m_frames->slotSize() < sharedFrameSlotSize(m_backend->inputSize())) {
+        qWarning() << "DetectionWorker frame slots too small for input" << m_backend->inputSize();
+        return -1;
+    }
+
+    for(int size : m_backend->supportedBatchSizes()) {
+        if(size > 0)
+            m_batchSizes.append(size);
+    }
+    if(m_batchSizes.isEmpty())
+        m_batchSizes.append(1);
+    std::sort(m_batchSizes.begin(), m_batchSizes.end());
+    const int maxBatch = m_batchSizes.last();
+
+    int processed = 0;
+    std::vector<SharedRing::Slot> batch;
+    for(;;) {
+        SharedRing::Slot first = m_frames->acquireRead(m_config.pollMs);
+        if(!first.isValid()) {
+            if(m_frames->isClosed())
+                break;
+            continue;
+        }
+        batch.clear();
+        batch.push_back(first);
+        // Only frames already waiting join the batch, nobody is held back
+        while(int(batch.size()) < maxBatch) {
+            SharedRing::Slot next = m_frames->tryAcquireRead();
+            if(!next.isValid())
+                break;
+            batch.push_back(next);
+        }
+        processed += int(batch.size());
+        processBatch(batch);
+    }
+    return processed;
+}
+
+void DetectionWorker::processBatch(std::vector<SharedRing::Slot> &batch)
+{
+    const int inputSize = m_backend->inputSize();
+    const size_t plane = 3 * size_t(inputSize) * inputSize;
+
+    std::vector<SharedFrameHeader> frames;
+    std::vector<SharedRing::Slot> valid;
+    frames.reserve(batch.size());
+    valid.reserve(batch.size());
+    for(SharedRing::Slot &slot : batch) {
+        SharedFrameHeader frame;
+        if(slot.size >= sizeof(frame))
+            std::memcpy(&frame, slot.data, sizeof(frame));
+        if(slot.size < sharedFrameSlotSize(inputSize) || frame.inputSize != inputSize) {
+            qWarning() << "DetectionWorker dropping malformed frame" << frame.frameId;
+            writeResult(frame, SharedResultHeader::Failed, {}, 0.f, 0.f);
+            m_frames->releaseRead(slot);
+            continue;
+        }
+        frames.push_back(frame);
+        valid.push_back(slot);
+    }
+    if(valid.empty())
+        return;
+
+    const int count = int(valid.size());
+    int batchSize = m_batchSizes.last();
+    for(int size : m_batchSizes) {
+        if(size >= count) {
+            batchSize = size;
+            break;
+        }
+    }
+
+    const float *input = nullptr;
+    if(batchSize == 1) {
+        input = sharedFrameInput(valid[0]);
+    } else {
+        m_staging.assign(size_t(batchSize) * plane, 0.f);
+        for(int i = 0; i < count; ++i)
+            std::memcpy(m_staging.data() + i * plane, sharedFrameInput(valid[i]), plane * sizeof(float));
+        input = m_staging.data();
+    }
+
+    InferenceOutput output;
+    QString error;
+    const auto inferStart = std::chrono::steady_clock::now();
+    bool ok = m_backend->infer(input, batchSize, output, &error);
+    const float inferMs = elapsedMs(inferStart);
+    if(ok && (output.shape.batch < count
+              || qint64(output.data.size()) < output.shape.extent() * qint64(sizeof(float)))) {
+        ok = false;
+        error = "backend output too small";
+    }
+
+    // The input is no longer needed, free the slots before parsing
+    for(SharedRing::Slot &slot : valid)
+        m_frames->releaseRead(slot);
+
+    if(!ok) {
+        qWarning() << "DetectionWorker inference failed:" << error;
+        for(const SharedFrameHeader &frame : frames)
+            writeResult(frame, SharedResultHeader::Failed, {}, inferMs, 0.f);
+        return;
+    }
+
+    const float *data = reinterpret_cast<const float*>(output.data.constData());
+    for(int i = 0; i < count; ++i) {
+        const SharedFrameHeader &frame = frames[i];
+        YoloParser::LetterboxInfo letterbox;
+        letterbox.scale = frame.scale;
+        letterbox.padX = frame.padX;
+        letterbox.padY = frame.padY;
+        letterbox.origW = frame.origW;
+        letterbox.origH = frame.origH;
+        letterbox.inputSize = frame.inputSize;
+
+        const auto parseStart = std::chrono::steady_clock::now();
+        const QList<Detection> detections = YoloParser::parse(
+            data, output.shape, letterbox, i,
+            m_config.confThreshold, m_config.iouThreshold,
+            nullptr, m_config.limits);
+        writeResult(frame, SharedResultHeader::Ok, detections, inferMs, elapsedMs(parseStart));
+    }
+}
+
+bool DetectionWorker::writeResult(const SharedFrameHeader &frame,
+                                  SharedResultHeader::Status status,
+                                  const QList<Detection> &detections,
+                                  float inferMs,
+                                  float parseMs)
+{
+    // Waits for the consumer while frames keep coming; once the frame ring
+    // is closed, results nobody drains are dropped so the worker can exit
+    SharedRing::Slot slot;
+    while(!slot.isValid()) {
+        slot = m_results->acquireWrite(m_config.pollMs);
+        if(slot.isValid())
+            break;
+        if(m_results->isClosed())
+            return false;
+        if(m_frames->isClosed()) {
+            qWarning() << "DetectionWorker dropping result of frame" << frame.frameId
+                       << "stream" << frame.streamId << ", result ring full at shutdown";
+            return false;
+        }
+    }
+
+    SharedResultHeader header;
+    header.frameId = frame.frameId;
+    header.streamId = frame.streamId;
+    header.status = status;
+    header.workerPid = qint32(getpid());
+    header.inferMs = inferMs;
+    header.parseMs = parseMs;
+
+    const qint32 fits = qint32((slot.capacity - sizeof(header)) / sizeof(SharedDetection));
+    header.count = std::min(qint32(detections.size()), fits);
+    std::memcpy(slot.data, &header, sizeof(header));
+
+    uchar *dst = slot.data + sizeof(header);
+    for(qint32 i = 0; i < header.count; ++i) {
+        const Detection &det = detections[i];
+        SharedDetection shared;
+        shared.classId = det.classId;
+        shared.score = det.score;
+        shared.x = det.rect.x();
+        shared.y = det.rect.y();
+        shared.width = det.rect.width();
+        shared.height = det.rect.height();
+        std::memcpy(dst + i * sizeof(shared), &shared, sizeof(shared));
+    }
+    m_results->commitWrite(slot, quint32(sizeof(header) + header.count * sizeof(SharedDetection)));
+    return true;
+}
+
+DetectionWorkerPool::DetectionWorkerPool(const DetectionWorker::Config &config,
+                                         int workers,
+                                         BackendFactory factory)
+    : m_config(config)
+    , m_workerCount(std::max(1, workers))
+    , m_factory(std::move(factory))
+{}
+
+DetectionWorkerPool::~DetectionWorkerPool()
+{
+    stop();
+}
+
+bool DetectionWorkerPool::start(QString *error)
+{
+    if(!m_pids.isEmpty())
+        return true;
+
+    m_frames = SharedRing::open(m_config.frameRing, error);
+    if(m_frames)
+        m_results = SharedRing::open(m_config.resultRing, error);
+    if(!m_frames || !m_results)
+        return false;
+
+    for(int i = 0; i < m_workerCount; ++i) {
+        const qint64 pid = spawn();
+        if(pid <= 0) {
+            if(error) *error = QString("fork failed: %1").arg(strerror(errno));
+            stop(0);
+            return false;
+        }
+        m_pids.append(pid);
+    }
+    return true;
+}
+
+qint64 DetectionWorkerPool::spawn()
+{
+    const pid_t pid = fork();
+    if(pid == 0) {
+        int code = 1;
+        {
+            DetectionWorker worker(m_factory ? m_factory() : nullptr, m_config);
+            code = worker.run() >= 0 ? 0 : 1;
+        }
+        // Skip the parent's atexit handlers and static destructors
+        _exit(code);
+    }
+    return pid;
+}
+
+int DetectionWorkerPool::supervise()
+{
+    int restarted = 0;
+    for(qint64 &pid : m_pids) {
+        if(pid <= 0)
+            continue;
+        int status = 0;
+        if(waitpid(pid_t(pid), &status, WNOHANG) != pid_t(pid))
+            continue;
+
+        const bool clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if(!clean) {
+            qWarning() << "DetectionWorker" << pid << "died, status" << status;
+            m_frames->recoverAbandoned();
+            m_results->recoverAbandoned();
+        }
+        pid = 0;
+        if(m_frames->isClosed())
+            continue;
+
+        pid = spawn();
+        if(pid > 0) {
+            ++restarted;
+            ++m_restarts;
+        } else {
+            qWarning() << "DetectionWorkerPool could not restart worker:" << strerror(errno);
+            pid = 0;
+        }
+    }
+    return restarted;
+}
+
+void DetectionWorkerPool::stop(int timeoutMs)
+{
+    if(m_frames)
+        m_frames->close();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for(qint64 &pid : m_pids) {
+        if(pid <= 0)
+            continue;
+        int status = 0;
+        while(waitpid(pid_t(pid), &status, WNOHANG) == 0) {
+            if(std::chrono::steady_clock::now() >= deadline) {
+                qWarning() << "DetectionWorker" << pid << "did not stop, killing it";
+                kill(pid_t(pid), SIGKILL);
+                waitpid(pid_t(pid), &status, 0);
+                // Hand back the frame and result slots it still held
+                m_frames->recoverAbandoned();
+                m_results->recoverAbandoned();
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        pid = 0;
+    }
+    m_pids.clear();
+}
+
+QList<qint64> DetectionWorkerPool::workerPids() const
+{
+    QList<qint64> pids;
+    for(qint64 pid : m_pids) {
+        if(pid > 0)
+            pids.append(pid);
+    }
+    return pids;
+}
@@ -0,0 +1,176 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef DETECTIONWORKER_H
+#define DETECTIONWORKER_H
+
+#include <QList>
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "inferencebackend.h"
+#include "sharedring.h"
+#include "yoloparser.h"
+
+// Frame ring slot: this header, then the planar float input at
+// sharedFrameInputOffset(), 3 x inputSize x inputSize
+struct SharedFrameHeader {
+    quint64 frameId = 0;
+    quint32 streamId = 0;
+    qint32 inputSize = 0;
+    float scale = 1.f;
+    qint32 padX = 0;
+    qint32 padY = 0;
+    qint32 origW = 0;
+    qint32 origH = 0;
+    qint64 timestampNs = 0;
+};
+
+// Result ring slot: this header, then count SharedDetection entries
+struct SharedResultHeader {
+    enum Status : qint32 {
+        Ok = 0,
+        Failed = 1
+    };
+
+    quint64 frameId = 0;
+    quint32 streamId = 0;
+    qint32 status = Ok;
+    qint32 count = 0;
+    qint32 workerPid = 0;
+    float inferMs = 0.f;
+    float parseMs = 0.f;
+};
+
+struct SharedDetection {
+    qint32 classId;
+    float score;
+    qint32 x;
+    qint32 y;
+    qint32 width;
+    qint32 height;
+};
+
+constexpr quint32 sharedFrameInputOffset() { return (sizeof(SharedFrameHeader) + 63) / 64 * 64; }
+constexpr quint32 sharedFrameSlotSize(int inputSize)
+{
+    return sharedFrameInputOffset() + 3u * quint32(inputSize) * quint32(inputSize) * sizeof(float);
+}
+constexpr quint32 sharedResultSlotSize(int maxDetections = MAX_DETECTIONS)
+{
+    return sizeof(SharedResultHeader) + quint32(maxDetections) * sizeof(SharedDetection);
+}
+
+// Producers letterbox straight into sharedFrameInput(), then set the header
+inline float *sharedFrameInput(const SharedRing::Slot &slot)
+{
+    return reinterpret_cast<float*>(slot.data + sharedFrameInputOffset());
+}
+void writeSharedFrameHeader(SharedRing::Slot &slot, const SharedFrameHeader &header);
+QList<Detection> readSharedDetections(const SharedRing::Slot &slot,
+                                      SharedResultHeader *header = nullptr);
+
+/**
+ * @brief Detector process body. Reads letterboxed frames from a shared
+ * frame ring, runs them through its own backend in the batch sizes the
+ * backend supports and writes detections to a shared result ring.
+ * Single frames are inferred straight from shared memory; larger batches
+ * are gathered into one contiguous buffer.
+ */
+class DetectionWorker
+{
+public:
+    struct Config {
+        QString frameRing;
+        QString resultRing;
+        float confThreshold = CONF_THRESH;
+        float iouThreshold = IOU_THRESH;
+        DecodeLimits limits;
+        int pollMs = 100;
+    };
+
+    DetectionWorker(std::shared_ptr<InferenceBackend> backend, const Config &config);
+
+    // Loads the backend and processes frames until the frame ring is closed
+    // and drained. Returns the number of frames processed, -1 on error.
+    int run();
+
+private:
+    std::shared_ptr<InferenceBackend> m_backend;
+    Config m_config;
+    std::unique_ptr<SharedRing> m_frames;
+    std::unique_ptr<SharedRing> m_results;
+    QList<int> m_batchSizes;
+    std::vector<float> m_staging;
+
+    void processBatch(std::vector<SharedRing::Slot> &batch);
+    bool writeResult(const SharedFrameHeader &frame, SharedResultHeader::Status status,
+                     const QList<Detection> &detections, float inferMs, float parseMs);
+};
+
+/**
+ * @brief Runs DetectionWorker in N forked processes and restarts the ones
+ * that die. Each child builds its own backend from the factory after the
+ * fork, so nothing of the parent's runtime is shared. Both rings must
+ * exist before start().
+ * Fork-based spawning is meant for Linux hosts; on macOS, frameworks such
+ * as CoreML are not fork-safe and workers should be separate executables
+ * calling DetectionWorker::run().
+ */
+class DetectionWorkerPool
+{
+public:
+    using BackendFactory = std::function<std::shared_ptr<InferenceBackend>()>;
+
+    DetectionWorkerPool(const DetectionWorker::Config &config,
+                        int workers,
+                        BackendFactory factory);
+    // Calls stop()
+    ~DetectionWorkerPool();
+
+    bool start(QString *error = nullptr);
+    // Reaps dead workers, recovers the ring slots they held and restarts
+    // them while the frame ring is open. Returns the number restarted.
+    int supervise();
+    // Closes the frame ring, lets the workers drain it and kills the ones
+    // still running after timeoutMs
+    void stop(int timeoutMs = 5000);
+
+    QList<qint64> workerPids() const;
+    int restartCount() const { return m_restarts; }
+
+private:
+    DetectionWorker::Config m_config;
+    int m_workerCount = 0;
+    BackendFactory m_factory;
+    std::unique_ptr<SharedRing> m_frames;
+    std::unique_ptr<SharedRing> m_results;
+    QList<qint64> m_pids;
+    int m_restarts = 0;
+
+    qint64 spawn();
+};
+
+#endif // DETECTIONWORKER_H
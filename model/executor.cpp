@@ -0,0 +1,386 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "executor.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct WorkerPool::Worker {
+    QMutex mutex;
+    std::deque<Task> tasks;
+    QThread *thread = nullptr;
+    std::atomic<qint64> busyNs{0};
+};
+
+static thread_local const WorkerPool *t_pool = nullptr;
+static thread_local int t_worker = -1;
+
+WorkerPool::WorkerPool(const PoolConfig &config)
+    : m_config(config)
+{
+    const int threads = std::max(1, m_config.threads);
+    m_config.threads = threads;
+
+    m_cpus = m_config.cpus;
+    if(m_cpus.isEmpty() && m_config.numaNode >= 0) {
+        m_cpus = numaNodeCpus(m_config.numaNode);
+        if(m_cpus.isEmpty())
+            qWarning() << "WorkerPool" << m_config.name
+                       << "found no CPUs for NUMA node" << m_config.numaNode;
+    }
+
+    m_uptime.start();
+    m_workers.reserve(threads);
+    for(int i = 0; i < threads; ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+
+    // All deques exist before the first worker can try to steal
+    for(int i = 0; i < threads; ++i) {
+        QThread *thread = QThread::create([this, i]() { run(i); });
+        thread->setObjectName(m_config.name + QString("-%1").arg(i));
+        m_workers[i]->thread = thread;
+        thread->start(m_config.priority);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        QMutexLocker locker(&m_sleepMutex);
+        m_stopping = true;
+        m_wake.wakeAll();
+    }
+    for(auto &worker : m_workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+}
+
+/**
+ * @brief Queues a task. From one of this pool's workers it goes on that
+ * worker's own deque, otherwise the deques are filled round-robin.
+ */
+void WorkerPool::submit(Task task)
+{
+    if(!task) return;
+
+    const int count = int(m_workers.size());
+    const int target = t_pool == this
+        ? t_worker
+        : int(m_nextWorker.fetch_add(1, std::memory_order_relaxed) % count);
+
+    m_submitted.fetch_add(1, std::memory_order_relaxed);
+    m_outstanding.fetch_add(1);
+    // Counted before the push so a worker taking the task cannot drive the
+    // count below zero; a worker seeing it early retries until the push lands
+    m_queued.fetch_add(1);
+    {
+        QMutexLocker locker(&m_workers[target]->mutex);
+        m_workers[target]->tasks.push_back(std::move(task));
+    }
+
+    // Woken under the sleep mutex so an idle worker cannot miss it
+    QMutexLocker locker(&m_sleepMutex);
+    m_wake.wakeOne();
+}
+
+void WorkerPool::waitForIdle()
+{
+    if(t_pool == this) {
+        qWarning() << "WorkerPool::waitForIdle called from worker of" << m_config.name;
+        return;
+    }
+    QMutexLocker locker(&m_sleepMutex);
+    while(m_outstanding.load() > 0)
+        m_idle.wait(&m_sleepMutex);
+}
+
+int WorkerPool::currentWorker() const
+{
+    return t_pool == this ? t_worker : -1;
+}
+
+PoolStats WorkerPool::stats() const
+{
+    PoolStats s;
+    s.name = m_config.name;
+    s.threads = int(m_workers.size());
+    s.submitted = m_submitted.load();
+    s.completed = m_completed.load();
+    s.stolen = m_stolen.load();
+    s.queued = m_queued.load();
+    qint64 busyNs = 0;
+    for(const auto &worker : m_workers)
+        busyNs += worker->busyNs.load(std::memory_order_relaxed);
+    s.busyMs = busyNs / 1e6;
+    s.uptimeMs = m_uptime.nsecsElapsed() / 1e6;
+    return s;
+}
+
+/**
+ * @brief Takes the newest task of the worker's own deque, or steals the
+ * oldest one of another worker.
+ */
+bool WorkerPool::take(int index, Task &task)
+{
+    Worker &own = *m_workers[index];
+    {
+        QMutexLocker locker(&own.mutex);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    const int count = int(m_workers.size());
+    for(int i = 1; i < count; ++i) {
+        Worker &victim = *m_workers[(index + i) % count];
+        QMutexLocker locker(&victim.mutex);
+        if(!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            m_stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(int index)
+{
+    t_pool = this;
+    t_worker = index;
+
+    // Pinning before the first task means the memory a worker touches first
+    // is allocated on its own NUMA node.
+    if(!m_cpus.isEmpty()) {
+        const int cpu = m_cpus.at(index % m_cpus.size());
+        if(!pinCurrentThread(cpu))
+            qWarning() << "WorkerPool" << m_config.name
+                       << "could not pin worker" << index << "to CPU" << cpu;
+    }
+
+    Worker &self = *m_workers[index];
+    for(;;) {
+        Task task;
+        if(take(index, task)) {
+            m_queued.fetch_sub(1);
+            auto start = std::chrono::steady_clock::now();
+            task();
+            auto end = std::chrono::steady_clock::now();
+            self.busyNs.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count(),
+                std::memory_order_relaxed);
+            m_completed.fetch_add(1, std::memory_order_relaxed);
+            if(m_outstanding.fetch_sub(1) == 1) {
+                QMutexLocker locker(&m_sleepMutex);
+                m_idle.wakeAll();
+            }
+            continue;
+        }
+
+        QMutexLocker locker(&m_sleepMutex);
+        // Queued but held by a worker that has not decremented yet, retry
+        if(m_queued.load() > 0)
+            continue;
+        if(m_stopping)
+            break;
+        m_wake.wait(&m_sleepMutex);
+    }
+
+    t_pool = nullptr;
+    t_worker = -1;
+}
+
+/**
+ * @brief Restricts the calling thread to one CPU. Only supported on Linux;
+ * elsewhere the scheduler decides and false is returned.
+ */
+bool WorkerPool::pinCurrentThread(int cpu)
+{
+#ifdef Q_OS_LINUX
+    if(cpu < 0 || cpu >= CPU_SETSIZE)
+        return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    Q_UNUSED(cpu);
+    return false;
+#endif
+}
+
+/**
+ * @brief CPUs belonging to a NUMA node, read from sysfs. Empty when the
+ * node does not exist or the platform has no NUMA information.
+ */
+QList<int> WorkerPool::numaNodeCpus(int node)
+{
+#ifdef Q_OS_LINUX
+    QFile file(QString("/sys/devices/system/node/node%1/cpulist").arg(node));
+    if(!file.open(QIODevice::ReadOnly))
+        return {};
+    return parseCpuList(QString::fromLatin1(file.readAll()));
+#else
+    Q_UNUSED(node);
+    return {};
+#endif
+}
+
+QList<int> WorkerPool::parseCpuList(const QString &list)
+{
+    QList<int> cpus;
+    const QStringList ranges = list.trimmed().split(',', Qt::SkipEmptyParts);
+    for(const QString &range : ranges) {
+        const QStringList bounds = range.trimmed().split('-');
+        bool okFirst = false;
+        bool okLast = true;
+        const int first = bounds.at(0).toInt(&okFirst);
+        const int last = bounds.size() > 1 ? bounds.at(1).toInt(&okLast) : first;
+        if(!okFirst || !okLast || bounds.size() > 2 || first < 0 || last < first) {
+            qWarning() << "Invalid cpulist entry:" << range;
+            return {};
+        }
+        for(int cpu = first; cpu <= last; ++cpu)
+            cpus.append(cpu);
+    }
+    return cpus;
+}
+
+TaskGroup::TaskGroup(WorkerPool *pool)
+    : m_pool(pool)
+{}
+
+TaskGroup::~TaskGroup()
+{
+    wait();
+}
+
+void TaskGroup::run(WorkerPool::Task task)
+{
+    if(!task) return;
+    if(!m_pool) {
+        task();
+        return;
+    }
+
+    m_pending.fetch_add(1);
+    m_pool->submit([this, task = std::move(task)]() {
+        task();
+        // Decremented under the mutex so wait() cannot return, and the
+        // group be destroyed, before this task is done touching it
+        QMutexLocker locker(&m_mutex);
+        if(m_pending.fetch_sub(1) == 1)
+            m_done.wakeAll();
+    });
+}
+
+void TaskGroup::wait()
+{
+    QMutexLocker locker(&m_mutex);
+    while(m_pending.load() > 0)
+        m_done.wait(&m_mutex);
+}
+
+Executor::Executor()
+    : m_config(defaultConfig())
+{}
+
+Executor &Executor::instance()
+{
+    static Executor executor;
+    return executor;
+}
+
+/**
+ * @brief Parsing gets half the cores, up to four since a batch holds at
+ * most four items; pre- and post-processing get two threads each.
+ */
+QList<PoolConfig> Executor::defaultConfig()
+{
+    const int cores = std::max(1, QThread::idealThreadCount());
+
+    PoolConfig preprocess;
+    preprocess.name = PREPROCESS;
+    preprocess.threads = std::min(2, cores);
+
+    PoolConfig parse;
+    parse.name = PARSE;
+    parse.threads = std::clamp(cores / 2, 1, 4);
+    parse.priority = QThread::HighPriority;
+
+    PoolConfig postprocess;
+    postprocess.name = POSTPROCESS;
+    postprocess.threads = std::min(2, cores);
+
+    return {preprocess, parse, postprocess};
+}
+
+bool Executor::configure(const QList<PoolConfig> &pools)
+{
+    QMutexLocker locker(&m_mutex);
+    if(m_started) {
+        qWarning() << "Executor::configure called after pools were created";
+        return false;
+    }
+    m_config = pools;
+    return true;
+}
+
+WorkerPool *Executor::pool(const QString &name)
+{
+    QMutexLocker locker(&m_mutex);
+    if(!m_started) {
+        for(const PoolConfig &config : std::as_const(m_config))
+            m_pools.push_back(std::make_unique<WorkerPool>(config));
+        m_started = true;
+    }
+    for(const auto &pool : m_pools) {
+        if(pool->name() == name)
+            return pool.get();
+    }
+    qWarning() << "Executor has no pool named" << name;
+    return nullptr;
+}
+
+QList<PoolStats> Executor::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<PoolStats> result;
+    for(const auto &pool : m_pools)
+        result.append(pool->stats());
+    return result;
+}
@@ -0,0 +1,173 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+struct PoolConfig {
+    QString name;
+    int threads = 1;
+    QThread::Priority priority = QThread::InheritPriority;
+    // Workers are pinned round-robin to these CPUs. When empty and numaNode
+    // is set, the node's CPUs are used; otherwise placement is left to the OS.
+    QList<int> cpus;
+    int numaNode = -1;
+};
+
+struct PoolStats {
+    QString name;
+    int threads = 0;
+    quint64 submitted = 0;
+    quint64 completed = 0;
+    quint64 stolen = 0;     // run by a worker other than the one it was queued on
+    int queued = 0;         // waiting, not yet picked up
+    double busyMs = 0.0;    // task time summed over all workers
+    double uptimeMs = 0.0;
+
+    // Fraction of worker time spent running tasks since the pool started
+    double utilization() const {
+        return (threads > 0 && uptimeMs > 0.0) ? busyMs / (uptimeMs * threads) : 0.0;
+    }
+};
+
+/**
+ * @brief Fixed set of worker threads, each with its own task deque.
+ * A worker pops its own deque from the back and, when empty, steals from
+ * the front of the others. Tasks submitted from a worker stay on that
+ * worker's deque, so follow-up work keeps its cache.
+ */
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkerPool(const PoolConfig &config);
+    // Runs the tasks still queued, then joins the workers
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void submit(Task task);
+    // Blocks until every submitted task has finished
+    void waitForIdle();
+
+    PoolStats stats() const;
+    const PoolConfig &config() const { return m_config; }
+    QString name() const { return m_config.name; }
+    int threadCount() const { return int(m_workers.size()); }
+    // Index of the calling worker in this pool, -1 on any other thread
+    int currentWorker() const;
+
+    static bool pinCurrentThread(int cpu);
+    static QList<int> numaNodeCpus(int node);
+    // Parses a Linux cpulist such as "0-3,8,10-11"
+    static QList<int> parseCpuList(const QString &list);
+
+private:
+    struct Worker;
+
+    PoolConfig m_config;
+    QList<int> m_cpus;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<int> m_queued{0};
+    std::atomic<int> m_outstanding{0};
+    std::atomic<quint64> m_submitted{0};
+    std::atomic<quint64> m_completed{0};
+    std::atomic<quint64> m_stolen{0};
+    std::atomic<unsigned> m_nextWorker{0};
+    QMutex m_sleepMutex;
+    QWaitCondition m_wake;
+    QWaitCondition m_idle;
+    bool m_stopping = false;
+    QElapsedTimer m_uptime;
+
+    void run(int index);
+    bool take(int index, Task &task);
+};
+
+/**
+ * @brief Tracks the tasks one owner submitted to a pool, so the owner can
+ * wait for its own work without waiting for everybody else's.
+ */
+class TaskGroup
+{
+public:
+    explicit TaskGroup(WorkerPool *pool = nullptr);
+    ~TaskGroup();
+
+    // Runs task on the pool, or inline when there is none
+    void run(WorkerPool::Task task);
+    void wait();
+    int pending() const { return m_pending.load(); }
+    WorkerPool *pool() const { return m_pool; }
+
+private:
+    WorkerPool *m_pool = nullptr;
+    std::atomic<int> m_pending{0};
+    QMutex m_mutex;
+    QWaitCondition m_done;
+};
+
+/**
+ * @brief Process-wide registry of the named pools used by the pipeline.
+ * Pools are created on first use from the configuration in effect then.
+ */
+class Executor
+{
+public:
+    static constexpr const char *PREPROCESS = "preprocess";
+    static constexpr const char *PARSE = "parse";
+    static constexpr const char *POSTPROCESS = "postprocess";
+
+    static Executor &instance();
+
+    // Sizes the default pools from the host's core count
+    static QList<PoolConfig> defaultConfig();
+
+    // Must be called before the first pool() call; returns false otherwise
+    bool configure(const QList<PoolConfig> &pools);
+    WorkerPool *pool(const QString &name);
+    QList<PoolStats> stats() const;
+
+private:
+    Executor();
+
+    mutable QMutex m_mutex;
+    QList<PoolConfig> m_config;
+    std::vector<std::unique_ptr<WorkerPool>> m_pools;
+    bool m_started = false;
+};
+
+#endif // EXECUTOR_H
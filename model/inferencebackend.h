@@ -0,0 +1,63 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef INFERENCEBACKEND_H
+#define INFERENCEBACKEND_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include "yoloparser.h"
+
+// Raw model output, ready to be handed to YoloParser
+struct InferenceOutput {
+    QByteArray data;
+    YoloParser::TensorShape shape {0, 0, 0};
+};
+
+/**
+ * @brief Model runtime used by the pipeline.
+ * Startup is split in two phases so each can be timed: load() locates and
+ * reads the model, compile() builds it for the device. infer() runs one
+ * NCHW float batch of batch x 3 x inputSize() x inputSize().
+ */
+class InferenceBackend
+{
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual bool load(QString *error) = 0;
+    virtual bool compile(QString *error) = 0;
+    virtual bool infer(const float *input, int batch,
+                       InferenceOutput &output, QString *error) = 0;
+
+    // Batch sizes the pipeline will submit, each one is warmed up at startup
+    virtual QList<int> supportedBatchSizes() const = 0;
+    virtual int inputSize() const { return INPUT_W; }
+    // Input sides the model accepts. Backends with flexible input shapes
+    // list several and switch between them with setInputSize().
+    virtual QList<int> supportedInputSizes() const { return {inputSize()}; }
+    virtual bool setInputSize(int size) { return size == inputSize(); }
+};
+
+#endif // INFERENCEBACKEND_H
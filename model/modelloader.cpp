@@ -0,0 +1,178 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "modelloader.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <chrono>
+#include <vector>
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+ModelLoader::ModelLoader(std::shared_ptr<InferenceBackend> backend, QObject *parent)
+    : QObject{parent}
+    , m_backend(std::move(backend))
+{}
+
+ModelLoader::~ModelLoader()
+{
+    wait();
+}
+
+/**
+ * @brief Starts loading on a dedicated thread. Calling it again while
+ * loading or once ready does nothing; after a failure it retries.
+ */
+void ModelLoader::start()
+{
+    const State current = state();
+    if(current == State::Loading || current == State::Ready)
+        return;
+    if(!m_backend) {
+        fail("No inference backend");
+        return;
+    }
+
+    wait();
+    setState(State::Loading);
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("ModelLoader");
+    m_thread->start();
+}
+
+void ModelLoader::wait()
+{
+    if(!m_thread) return;
+    m_thread->wait();
+    delete m_thread;
+    m_thread = nullptr;
+}
+
+StartupTimings ModelLoader::timings() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_timings;
+}
+
+QString ModelLoader::errorString() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_error;
+}
+
+/**
+ * @brief Loader thread body: load, compile, then one warm-up prediction per
+ * supported batch size so that specialization happens before real frames.
+ */
+void ModelLoader::run()
+{
+    StartupTimings timings;
+    QString error;
+    const auto startAll = std::chrono::high_resolution_clock::now();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if(!m_backend->load(&error)) {
+        fail("Model load failed: " + error);
+        return;
+    }
+    timings.loadMs = elapsedMs(start);
+
+    start = std::chrono::high_resolution_clock::now();
+    if(!m_backend->compile(&error)) {
+        fail("Model compile failed: " + error);
+        return;
+    }
+    timings.compileMs = elapsedMs(start);
+
+    // Other input sizes are warmed as well, so a runtime resolution switch
+    // does not pay for specialization on a live frame. Timings are kept for
+    // the default size.
+    const int defaultSize = m_backend->inputSize();
+    QList<int> sizes = m_backend->supportedInputSizes();
+    sizes.removeAll(defaultSize);
+    sizes.prepend(defaultSize);
+    const QList<int> batchSizes = m_backend->supportedBatchSizes();
+    for(int size : sizes) {
+        if(!m_backend->setInputSize(size)) {
+            qWarning() << "Backend rejected input size" << size;
+            continue;
+        }
+        for(int batch : batchSizes) {
+            if(batch <= 0) continue;
+            // Mid-grey like letterbox padding, keeps activations realistic
+            std::vector<float> dummy(size_t(batch) * 3 * size * size, 114.f / 255.f);
+            InferenceOutput output;
+
+            start = std::chrono::high_resolution_clock::now();
+            if(!m_backend->infer(dummy.data(), batch, output, &error)) {
+                m_backend->setInputSize(defaultSize);
+                fail(QString("Warm-up failed for batch %1 at %2 px: %3")
+                         .arg(batch).arg(size).arg(error));
+                return;
+            }
+            const double ms = elapsedMs(start);
+            if(size != defaultSize)
+                continue;
+            if(timings.warmUpMs.isEmpty())
+                timings.firstInferenceMs = ms;
+            timings.warmUpMs.insert(batch, ms);
+        }
+    }
+    m_backend->setInputSize(defaultSize);
+    timings.totalMs = elapsedMs(startAll);
+
+    qInfo() << "Model ready in" << timings.totalMs << "ms"
+            << "(load" << timings.loadMs
+            << "compile" << timings.compileMs
+            << "first inference" << timings.firstInferenceMs << ")";
+
+    {
+        QMutexLocker lock(&m_mutex);
+        m_timings = timings;
+    }
+    setState(State::Ready);
+    emit ready(timings);
+}
+
+void ModelLoader::setState(State state)
+{
+    m_state = state;
+    emit stateChanged(state);
+}
+
+void ModelLoader::fail(const QString &error)
+{
+    qWarning() << error;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_error = error;
+    }
+    setState(State::Failed);
+    emit failed(error);
+}
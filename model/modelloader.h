@@ -0,0 +1,95 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef MODELLOADER_H
+#define MODELLOADER_H
+
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+#include "inferencebackend.h"
+
+class QThread;
+
+struct StartupTimings {
+    double loadMs = 0.0;            // model lookup and read
+    double compileMs = 0.0;         // device specialization
+    double firstInferenceMs = 0.0;  // first warm-up prediction
+    QMap<int, double> warmUpMs;     // warm-up per batch size
+    double totalMs = 0.0;
+};
+
+/**
+ * @brief Loads, compiles and warms up an InferenceBackend off the caller's
+ * thread. Frames must not be submitted to the backend until ready() fires.
+ */
+class ModelLoader : public QObject
+{
+    Q_OBJECT
+public:
+    enum class State {
+        Idle,
+        Loading,
+        Ready,
+        Failed
+    };
+    Q_ENUM(State)
+
+    explicit ModelLoader(std::shared_ptr<InferenceBackend> backend,
+                         QObject *parent = nullptr);
+    ~ModelLoader();
+
+    void start();
+    // Blocks until the loader thread is done, for shutdown and tests
+    void wait();
+
+    State state() const { return m_state.load(); }
+    bool isReady() const { return state() == State::Ready; }
+    StartupTimings timings() const;
+    QString errorString() const;
+
+signals:
+    void stateChanged(ModelLoader::State state);
+    void ready(StartupTimings timings);
+    void failed(QString error);
+
+private:
+    std::shared_ptr<InferenceBackend> m_backend;
+    QThread *m_thread = nullptr;
+    std::atomic<State> m_state{State::Idle};
+    mutable QMutex m_mutex;
+    StartupTimings m_timings;
+    QString m_error;
+
+    void run();
+    void setState(State state);
+    void fail(const QString &error);
+};
+
+Q_DECLARE_METATYPE(StartupTimings)
+
+#endif // MODELLOADER_H
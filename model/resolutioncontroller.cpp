@@ -0,0 +1,160 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "resolutioncontroller.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+ResolutionController::ResolutionController(QObject *parent)
+    : ResolutionController(defaultSizes(), Options(), parent)
+{}
+
+ResolutionController::ResolutionController(const QList<int> &sizes,
+                                           const Options &options,
+                                           QObject *parent)
+    : QObject{parent}, m_options(options)
+{
+    setSizes(sizes);
+}
+
+void ResolutionController::setSizes(const QList<int> &sizes)
+{
+    const int current = inputSize();
+    QList<int> sorted;
+    for(int size : sizes) {
+        if(size > 0 && !sorted.contains(size))
+            sorted.append(size);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    if(sorted.isEmpty()) {
+        qWarning() << "ResolutionController needs at least one input size";
+        return;
+    }
+
+    m_sizes = sorted;
+    const int index = m_sizes.indexOf(current);
+    m_index = index >= 0 ? index : int(m_sizes.size()) - 1;
+    m_frameMs = 0.0;
+    m_over = 0;
+    m_under = 0;
+    m_cooldown = 0;
+}
+
+void ResolutionController::setTargetFps(double fps)
+{
+    if(fps <= 0.0) {
+        qWarning() << "ResolutionController ignoring target fps" << fps;
+        return;
+    }
+    m_options.targetFps = fps;
+    m_over = 0;
+    m_under = 0;
+}
+
+/**
+ * @brief Updates the smoothed per-frame cost and steps the input size when
+ * the budget has been missed, or would be met by a larger size, for
+ * `patience` samples in a row.
+ * @param latency, stage timings of the batch just finished
+ * @return input size for the next batch
+ */
+int ResolutionController::report(const StageLatency &latency)
+{
+    if(m_sizes.isEmpty() || latency.frames <= 0)
+        return inputSize();
+
+    const double sample = latency.frameMs();
+    m_frameMs = m_samples == 0 || m_frameMs <= 0.0
+        ? sample
+        : m_frameMs + m_options.smoothing * (sample - m_frameMs);
+    ++m_samples;
+    m_framesAtSize[inputSize()] += quint64(latency.frames);
+
+    if(m_cooldown > 0) {
+        --m_cooldown;
+        return inputSize();
+    }
+
+    const double budget = budgetMs();
+    if(m_index > 0 && m_frameMs > budget * m_options.downThreshold) {
+        m_under = 0;
+        if(++m_over >= m_options.patience)
+            switchTo(m_index - 1);
+        return inputSize();
+    }
+    m_over = 0;
+
+    if(m_index + 1 < int(m_sizes.size())) {
+        const double ratio = double(m_sizes.at(m_index + 1)) / m_sizes.at(m_index);
+        if(m_frameMs * ratio * ratio < budget * m_options.upThreshold) {
+            if(++m_under >= m_options.patience)
+                switchTo(m_index + 1);
+            return inputSize();
+        }
+    }
+    m_under = 0;
+    return inputSize();
+}
+
+ResolutionStats ResolutionController::stats() const
+{
+    ResolutionStats stats;
+    stats.inputSize = inputSize();
+    stats.frameMs = m_frameMs;
+    stats.budgetMs = budgetMs();
+    stats.samples = m_samples;
+    stats.stepsDown = m_stepsDown;
+    stats.stepsUp = m_stepsUp;
+    stats.framesAtSize = m_framesAtSize;
+    return stats;
+}
+
+double ResolutionController::budgetMs() const
+{
+    return m_options.targetFps > 0.0 ? 1000.0 / m_options.targetFps : 0.0;
+}
+
+void ResolutionController::switchTo(int index)
+{
+    const int previous = inputSize();
+    const double previousMs = m_frameMs;
+    m_index = index;
+    const int size = inputSize();
+    if(size < previous)
+        ++m_stepsDown;
+    else
+        ++m_stepsUp;
+
+    // Carry the estimate over to the new size so the first samples there
+    // are blended with a sensible starting point
+    const double ratio = double(size) / previous;
+    m_frameMs *= ratio * ratio;
+    m_over = 0;
+    m_under = 0;
+    m_cooldown = m_options.cooldown;
+
+    qInfo() << "Input resolution" << previous << "->" << size
+            << "at" << previousMs << "ms per frame, budget" << budgetMs() << "ms";
+    emit resolutionChanged(previous, size, previousMs);
+}
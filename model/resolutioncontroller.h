@@ -0,0 +1,115 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef RESOLUTIONCONTROLLER_H
+#define RESOLUTIONCONTROLLER_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+
+// Measured cost of one batch through the pipeline
+struct StageLatency {
+    double preprocessMs = 0.0;  // summed over the frames of the batch
+    double inferMs = 0.0;
+    double parseMs = 0.0;
+    int frames = 1;
+
+    double frameMs() const {
+        return frames > 0 ? (preprocessMs + inferMs + parseMs) / frames : 0.0;
+    }
+};
+
+struct ResolutionStats {
+    int inputSize = 0;
+    double frameMs = 0.0;       // smoothed cost per frame at inputSize
+    double budgetMs = 0.0;      // per frame, from the target fps
+    quint64 samples = 0;
+    quint64 stepsDown = 0;
+    quint64 stepsUp = 0;
+    QMap<int, quint64> framesAtSize;
+
+    quint64 switches() const { return stepsDown + stepsUp; }
+};
+
+/**
+ * @brief Picks the model input size that keeps the pipeline at a target
+ * frame rate. Each reported batch updates a smoothed per-frame cost; when
+ * it stays over budget the input steps down one size, and when the next
+ * larger size is predicted to fit with headroom it steps back up.
+ * Predictions scale the measured cost by the input area. A switch needs
+ * several agreeing samples and is followed by a cooldown, so a single slow
+ * batch does not make the resolution oscillate.
+ * Not thread-safe; report() and the accessors belong to one thread.
+ */
+class ResolutionController : public QObject
+{
+    Q_OBJECT
+public:
+    struct Options {
+        double targetFps = 30.0;
+        double smoothing = 0.2;         // weight of the newest sample
+        double downThreshold = 1.0;     // step down above this share of the budget
+        double upThreshold = 0.75;      // step up when predicted below this share
+        int patience = 3;               // agreeing samples needed to switch
+        int cooldown = 10;              // samples ignored after a switch
+    };
+
+    static QList<int> defaultSizes() { return {320, 480, 640}; }
+
+    explicit ResolutionController(QObject *parent = nullptr);
+    ResolutionController(const QList<int> &sizes, const Options &options,
+                         QObject *parent = nullptr);
+
+    // Restricts the sizes, e.g. to the ones the backend accepts. Starts from
+    // the largest one unless the current size is still allowed.
+    void setSizes(const QList<int> &sizes);
+    QList<int> sizes() const { return m_sizes; }
+    void setTargetFps(double fps);
+    double targetFps() const { return m_options.targetFps; }
+
+    int inputSize() const { return m_sizes.value(m_index, 0); }
+    // Feeds one measured batch and returns the size for the next batch
+    int report(const StageLatency &latency);
+    ResolutionStats stats() const;
+
+signals:
+    void resolutionChanged(int previousSize, int size, double frameMs);
+
+private:
+    QList<int> m_sizes;
+    Options m_options;
+    int m_index = 0;
+    double m_frameMs = 0.0;
+    int m_over = 0;
+    int m_under = 0;
+    int m_cooldown = 0;
+    quint64 m_samples = 0;
+    quint64 m_stepsDown = 0;
+    quint64 m_stepsUp = 0;
+    QMap<int, quint64> m_framesAtSize;
+
+    double budgetMs() const;
+    void switchTo(int index);
+};
+
+#endif // RESOLUTIONCONTROLLER_H
@@ -0,0 +1,438 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "sharedring.h"
+
+#include <QDebug>
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <chrono>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef Q_OS_LINUX
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+static constexpr quint32 RING_MAGIC = 0x4f445231;   // "ODR1"
+static constexpr quint32 RING_VERSION = 1;
+static constexpr quint32 SLOT_ABANDONED = 0x1;
+static constexpr size_t CACHE_LINE = 64;
+
+static_assert(std::atomic<quint64>::is_always_lock_free,
+              "shared ring needs address-free 64-bit atomics");
+static_assert(std::atomic<quint32>::is_always_lock_free,
+              "shared ring needs address-free 32-bit atomics");
+
+struct alignas(CACHE_LINE) SharedRingHeader {
+    std::atomic<quint32> magic;
+    quint32 version;
+    quint32 slotCount;
+    quint32 slotSize;
+    quint64 slotStride;
+
+    alignas(CACHE_LINE) std::atomic<quint64> enqueuePos;
+    alignas(CACHE_LINE) std::atomic<quint64> dequeuePos;
+
+    alignas(CACHE_LINE) std::atomic<quint32> dataSignal;
+    std::atomic<quint32> dataWaiters;
+    alignas(CACHE_LINE) std::atomic<quint32> spaceSignal;
+    std::atomic<quint32> spaceWaiters;
+    std::atomic<quint32> closed;
+};
+
+// A slot whose sequence equals its position is free to write; position + 1
+// means committed and ready to read. Releasing moves it one lap ahead.
+struct alignas(CACHE_LINE) SharedSlotHeader {
+    std::atomic<quint64> sequence;
+    std::atomic<qint32> owner;
+    quint32 size;
+    quint32 flags;
+};
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static QByteArray shmName(const QString &name)
+{
+    QString path = name;
+    if(!path.startsWith('/'))
+        path.prepend('/');
+    return path.toUtf8();
+}
+
+static void setError(QString *error, const QString &message)
+{
+    if(error) *error = message;
+}
+
+static bool processAlive(qint32 pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static void waitOn(std::atomic<quint32> *word, quint32 expected, int timeoutMs)
+{
+#ifdef Q_OS_LINUX
+    timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = long(timeoutMs % 1000) * 1000000L;
+    // Not FUTEX_PRIVATE: the word lives in memory shared across processes
+    syscall(SYS_futex, reinterpret_cast<quint32*>(word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    Q_UNUSED(expected);
+    std::this_thread::sleep_for(std::chrono::milliseconds(qMin(timeoutMs, 1)));
+#endif
+}
+
+static void wakeAll(std::atomic<quint32> *word)
+{
+#ifdef Q_OS_LINUX
+    syscall(SYS_futex, reinterpret_cast<quint32*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    Q_UNUSED(word);
+#endif
+}
+
+static void notify(std::atomic<quint32> &word, std::atomic<quint32> &waiters)
+{
+    word.fetch_add(1);
+    if(waiters.load() > 0)
+        wakeAll(&word);
+}
+
+std::unique_ptr<SharedRing> SharedRing::create(const QString &name,
+                                               quint32 slotCount,
+                                               quint32 slotSize,
+                                               QString *error)
+{
+    // Two slots at least, so writer- and reader-held slots can be told apart
+    if(slotCount < 2 || slotSize == 0) {
+        setError(error, QString("Invalid ring geometry %1 x %2").arg(slotCount).arg(slotSize));
+        return nullptr;
+    }
+
+    const QByteArray path = shmName(name);
+    shm_unlink(path.constData());
+    const int fd = shm_open(path.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0) {
+        setError(error, QString("shm_open %1 failed: %2").arg(name, strerror(errno)));
+        return nullptr;
+    }
+
+    const size_t stride = alignUp(sizeof(SharedSlotHeader) + slotSize, CACHE_LINE);
+    const size_t length = alignUp(sizeof(SharedRingHeader), CACHE_LINE) + stride * slotCount;
+    if(ftruncate(fd, off_t(length)) != 0) {
+        setError(error, QString("ftruncate %1 failed: %2").arg(name, strerror(errno)));
+        ::close(fd);
+        shm_unlink(path.constData());
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedRing> ring(new SharedRing);
+    ring->m_name = name;
+    ring->m_owner = true;
+    const bool mapped = ring->map(fd, length, error);
+    ::close(fd);
+    if(!mapped)
+        return nullptr;
+
+    SharedRingHeader *header = new (ring->m_base) SharedRingHeader;
+    header->version = RING_VERSION;
+    header->slotCount = slotCount;
+    header->slotSize = slotSize;
+    header->slotStride = stride;
+    header->enqueuePos.store(0);
+    header->dequeuePos.store(0);
+    header->dataSignal.store(0);
+    header->dataWaiters.store(0);
+    header->spaceSignal.store(0);
+    header->spaceWaiters.store(0);
+    header->closed.store(0);
+    ring->m_header = header;
+
+    for(quint32 i = 0; i < slotCount; ++i) {
+        SharedSlotHeader *slot = new (ring->slotAt(i)) SharedSlotHeader;
+        slot->sequence.store(i);
+        slot->owner.store(0);
+        slot->size = 0;
+        slot->flags = 0;
+    }
+    // Openers check the magic last, once everything above is visible
+    header->magic.store(RING_MAGIC, std::memory_order_release);
+    return ring;
+}
+
+std::unique_ptr<SharedRing> SharedRing::open(const QString &name, QString *error)
+{
+    const QByteArray path = shmName(name);
+    const int fd = shm_open(path.constData(), O_RDWR, 0600);
+    if(fd < 0) {
+        setError(error, QString("shm_open %1 failed: %2").arg(name, strerror(errno)));
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SharedRingHeader)) {
+        setError(error, QString("Shared ring %1 is truncated").arg(name));
+        ::close(fd);
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedRing> ring(new SharedRing);
+    ring->m_name = name;
+    const bool mapped = ring->map(fd, size_t(info.st_size), error);
+    ::close(fd);
+    if(!mapped)
+        return nullptr;
+
+    SharedRingHeader *header = reinterpret_cast<SharedRingHeader*>(ring->m_base);
+    if(header->magic.load(std::memory_order_acquire) != RING_MAGIC
+        || header->version != RING_VERSION) {
+        setError(error, QString("Shared ring %1 is not initialized").arg(name));
+        return nullptr;
+    }
+    const size_t needed = alignUp(sizeof(SharedRingHeader), CACHE_LINE)
+                          + header->slotStride * header->slotCount;
+    if(needed > ring->m_length) {
+        setError(error, QString("Shared ring %1 is truncated").arg(name));
+        return nullptr;
+    }
+    ring->m_header = header;
+    return ring;
+}
+
+SharedRing::~SharedRing()
+{
+    if(m_base)
+        munmap(m_base, m_length);
+    if(m_owner)
+        shm_unlink(shmName(m_name).constData());
+}
+
+bool SharedRing::map(int fd, size_t length, QString *error)
+{
+    void *base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(base == MAP_FAILED) {
+        setError(error, QString("mmap %1 failed: %2").arg(m_name, strerror(errno)));
+        return false;
+    }
+    m_base = static_cast<uchar*>(base);
+    m_length = length;
+    return true;
+}
+
+quint32 SharedRing::slotCount() const
+{
+    return m_header->slotCount;
+}
+
+quint32 SharedRing::slotSize() const
+{
+    return m_header->slotSize;
+}
+
+SharedSlotHeader *SharedRing::slotAt(quint64 position) const
+{
+    const size_t index = size_t(position % m_header->slotCount);
+    return reinterpret_cast<SharedSlotHeader*>(
+        m_base + alignUp(sizeof(SharedRingHeader), CACHE_LINE) + index * m_header->slotStride);
+}
+
+uchar *SharedRing::payload(SharedSlotHeader *slot) const
+{
+    return reinterpret_cast<uchar*>(slot) + sizeof(SharedSlotHeader);
+}
+
+SharedRing::Slot SharedRing::tryAcquireWrite()
+{
+    if(m_header->closed.load())
+        return {};
+
+    quint64 pos = m_header->enqueuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        SharedSlotHeader *slot = slotAt(pos);
+        const quint64 seq = slot->sequence.load(std::memory_order_acquire);
+        const qint64 dif = qint64(seq) - qint64(pos);
+        if(dif == 0) {
+            if(m_header->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot->owner.store(qint32(getpid()), std::memory_order_relaxed);
+                Slot result;
+                result.data = payload(slot);
+                result.capacity = m_header->slotSize;
+                result.position = pos;
+                return result;
+            }
+        } else if(dif < 0) {
+            return {};  // full
+        } else {
+            pos = m_header->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+SharedRing::Slot SharedRing::acquireWrite(int timeoutMs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for(;;) {
+        const quint32 signalled = m_header->spaceSignal.load();
+        Slot slot = tryAcquireWrite();
+        if(slot.isValid() || isClosed())
+            return slot;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if(left <= 0)
+            return {};
+        m_header->spaceWaiters.fetch_add(1);
+        waitOn(&m_header->spaceSignal, signalled, int(left));
+        m_header->spaceWaiters.fetch_sub(1);
+    }
+}
+
+void SharedRing::commitWrite(Slot &slot, quint32 size)
+{
+    if(!slot.isValid()) return;
+    SharedSlotHeader *header = slotAt(slot.position);
+    header->size = qMin(size, m_header->slotSize);
+    header->flags = 0;
+    header->owner.store(0, std::memory_order_relaxed);
+    header->sequence.store(slot.position + 1, std::memory_order_release);
+    slot = Slot();
+    notify(m_header->dataSignal, m_header->dataWaiters);
+}
+
+SharedRing::Slot SharedRing::tryAcquireRead()
+{
+    quint64 pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+    for(;;) {
+        SharedSlotHeader *slot = slotAt(pos);
+        const quint64 seq = slot->sequence.load(std::memory_order_acquire);
+        const qint64 dif = qint64(seq) - qint64(pos + 1);
+        if(dif == 0) {
+            if(!m_header->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                continue;
+            slot->owner.store(qint32(getpid()), std::memory_order_relaxed);
+            Slot result;
+            result.data = payload(slot);
+            result.capacity = m_header->slotSize;
+            result.size = slot->size;
+            result.position = pos;
+            if(!(slot->flags & SLOT_ABANDONED))
+                return result;
+            // Left behind by a dead writer, skip it
+            releaseRead(result);
+            pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+        } else if(dif < 0) {
+            return {};  // empty
+        } else {
+            pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+SharedRing::Slot SharedRing::acquireRead(int timeoutMs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for(;;) {
+        const quint32 signalled = m_header->dataSignal.load();
+        Slot slot = tryAcquireRead();
+        if(slot.isValid() || isClosed())
+            return slot;
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if(left <= 0)
+            return {};
+        m_header->dataWaiters.fetch_add(1);
+        waitOn(&m_header->dataSignal, signalled, int(left));
+        m_header->dataWaiters.fetch_sub(1);
+    }
+}
+
+void SharedRing::releaseRead(Slot &slot)
+{
+    if(!slot.isValid()) return;
+    SharedSlotHeader *header = slotAt(slot.position);
+    header->owner.store(0, std::memory_order_relaxed);
+    header->sequence.store(slot.position + m_header->slotCount, std::memory_order_release);
+    slot = Slot();
+    notify(m_header->spaceSignal, m_header->spaceWaiters);
+}
+
+/**
+ * @brief Takes back slots held by processes that no longer exist.
+ * A process that dies between claiming a slot and recording its pid is
+ * not detected; that window is a few instructions long.
+ */
+int SharedRing::recoverAbandoned()
+{
+    int recovered = 0;
+    const quint32 count = m_header->slotCount;
+    for(quint32 i = 0; i < count; ++i) {
+        SharedSlotHeader *slot = slotAt(i);
+        qint32 owner = slot->owner.load();
+        if(owner == 0 || processAlive(owner))
+            continue;
+        if(!slot->owner.compare_exchange_strong(owner, 0))
+            continue;
+
+        const quint64 seq = slot->sequence.load(std::memory_order_acquire);
+        if(seq % count == i) {
+            // Claimed by a writer: publish it empty so readers move past it
+            slot->size = 0;
+            slot->flags = SLOT_ABANDONED;
+            slot->sequence.store(seq + 1, std::memory_order_release);
+            notify(m_header->dataSignal, m_header->dataWaiters);
+        } else {
+            // Claimed by a reader: free it for the next lap
+            slot->sequence.store(seq - 1 + count, std::memory_order_release);
+            notify(m_header->spaceSignal, m_header->spaceWaiters);
+        }
+        ++recovered;
+    }
+    if(recovered > 0)
+        qWarning() << "SharedRing" << m_name << "recovered" << recovered << "abandoned slots";
+    return recovered;
+}
+
+void SharedRing::close()
+{
+    m_header->closed.store(1);
+    notify(m_header->dataSignal, m_header->dataWaiters);
+    notify(m_header->spaceSignal, m_header->spaceWaiters);
+}
+
+bool SharedRing::isClosed() const
+{
+    return m_header->closed.load() != 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef SHAREDRING_H
+#define SHAREDRING_H
+
+#include <QString>
+#include <QtGlobal>
+
+#include <memory>
+
+struct SharedRingHeader;
+struct SharedSlotHeader;
+
+/**
+ * @brief Fixed-slot ring in POSIX shared memory, shared by any number of
+ * writer and reader processes.
+ * Slots are filled and read in place: a writer acquires a slot, writes
+ * into Slot::data and commits it; a reader acquires the oldest committed
+ * slot and releases it when done, so payloads are never copied.
+ * Waiting uses a futex on Linux and short sleeps elsewhere.
+ *
+ * Every acquired slot records the pid holding it. If that process dies,
+ * recoverAbandoned() hands the slot back: a reader's slot becomes free
+ * again, a writer's slot is skipped by readers.
+ */
+class SharedRing
+{
+public:
+    struct Slot {
+        uchar *data = nullptr;
+        quint32 capacity = 0;
+        quint32 size = 0;       // bytes committed, filled in for readers
+        quint64 position = 0;
+        bool isValid() const { return data != nullptr; }
+    };
+
+    // Creates the ring, replacing a stale one of the same name. The ring is
+    // unlinked when the creating object is destroyed.
+    static std::unique_ptr<SharedRing> create(const QString &name,
+                                              quint32 slotCount,
+                                              quint32 slotSize,
+                                              QString *error = nullptr);
+    static std::unique_ptr<SharedRing> open(const QString &name,
+                                            QString *error = nullptr);
+    ~SharedRing();
+
+    SharedRing(const SharedRing &) = delete;
+    SharedRing &operator=(const SharedRing &) = delete;
+
+    // Writer side
+    Slot tryAcquireWrite();
+    Slot acquireWrite(int timeoutMs);
+    void commitWrite(Slot &slot, quint32 size);
+
+    // Reader side
+    Slot tryAcquireRead();
+    Slot acquireRead(int timeoutMs);
+    void releaseRead(Slot &slot);
+
+    // Returns the number of slots taken back from dead processes
+    int recoverAbandoned();
+
+    // Wakes every waiter; readers still drain committed slots, writers fail
+    void close();
+    bool isClosed() const;
+
+    QString name() const { return m_name; }
+    quint32 slotCount() const;
+    quint32 slotSize() const;
+
+private:
+    SharedRing() = default;
+
+    QString m_name;
+    bool m_owner = false;
+    uchar *m_base = nullptr;
+    size_t m_length = 0;
+    SharedRingHeader *m_header = nullptr;
+
+    SharedSlotHeader *slotAt(quint64 position) const;
+    uchar *payload(SharedSlotHeader *slot) const;
+    bool map(int fd, size_t length, QString *error);
+};
+
+#endif // SHAREDRING_H
@@ -21,13 +21,15 @@
 // Copyright (C) 2025 José de Jesús Deloya Cruz
 
 #include "yoloparser.h"
+#include "cropstage.h"
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <numeric>
 #include <unordered_map>
 
 #include <QDebug>
-#include <QFuture>
-#include <QtConcurrent/QtConcurrent>
+#include <QMetaObject>
 
 const QStringList YoloParser::YOLO_CLASSES = {
     "person","bicycle","car","motorcycle","airplane","bus","train","truck",
@@ -44,8 +46,10 @@ const QStringList YoloParser::YOLO_CLASSES = {
     "toothbrush"
 };
 
-YoloParser::YoloParser(QObject *parent)
+YoloParser::YoloParser(std::shared_ptr<DetectionMailbox> mailbox, QObject *parent)
     : QObject{parent}
+    , m_mailbox(std::move(mailbox))
+    , m_tasks(Executor::instance().pool(Executor::PARSE))
 {}
 
 /**
@@ -120,6 +124,419 @@ std::vector<int> YoloParser::nms(const std::vector<float>& xs,
     return keep;
 }
 
+// State shared by the pool tasks decoding one batch
+struct YoloParser::BatchJob {
+    QByteArray blob;
+    TensorShape shape{0, 0, 0};
+    QVector<LetterboxInfo> letterboxInfo;
+    QList<CropSource> sources;
+    DetectionFilter filter;
+    DecodeLimits limits;
+    QVector<QList<Detection>> detections;
+    QVector<ParseStats> stats;
+    std::atomic<int> remaining{0};
+    std::chrono::high_resolution_clock::time_point start;
+    double ms = 0.0;
+};
+
+struct YoloParser::Candidates {
+    std::vector<float> cx;
+    std::vector<float> cy;
+    std::vector<float> w;
+    std::vector<float> h;
+    std::vector<float> score;
+    std::vector<int> classId;
+
+    void reserve(size_t n) {
+        cx.reserve(n);
+        cy.reserve(n);
+        w.reserve(n);
+        h.reserve(n);
+        score.reserve(n);
+        classId.reserve(n);
+    }
+
+    void push(float x, float y, float bw, float bh, float s, int c) {
+        cx.push_back(x);
+        cy.push_back(y);
+        w.push_back(bw);
+        h.push_back(bh);
+        score.push_back(s);
+        classId.push_back(c);
+    }
+
+    void copy(size_t from, size_t to) {
+        cx[to] = cx[from];
+        cy[to] = cy[from];
+        w[to] = w[from];
+        h[to] = h[from];
+        score[to] = score[from];
+        classId[to] = classId[from];
+    }
+
+    void resize(size_t n) {
+        cx.resize(n);
+        cy.resize(n);
+        w.resize(n);
+        h.resize(n);
+        score.resize(n);
+        classId.resize(n);
+    }
+
+    size_t size() const { return score.size(); }
+    bool empty() const { return score.empty(); }
+};
+
+YoloParser::TensorLayout YoloParser::TensorShape::layout() const
+{
+    if(strideN() == 1 && strideC() >= boxes)
+        return TensorLayout::ChannelMajor;
+    if(strideC() == 1 && strideN() >= channels)
+        return TensorLayout::AnchorMajor;
+    return TensorLayout::Strided;
+}
+
+qint64 YoloParser::TensorShape::extent() const
+{
+    if(batch <= 0 || channels <= 0 || boxes <= 0) return 0;
+    return qint64(batch - 1) * strideB()
+         + qint64(channels - 1) * strideC()
+         + qint64(boxes - 1) * strideN() + 1;
+}
+
+/**
+ * @brief Builds a TensorShape from the dims and strides of a rank-3 tensor.
+ * @param dims, tensor dims, either [B, C, N] or [B, N, C]
+ * @param strides, element strides for each dim
+ * @return
+ */
+YoloParser::TensorShape YoloParser::shapeFromTensor(const int dims[3], const qint64 strides[3])
+{
+    TensorShape shape {dims[0], dims[1], dims[2]};
+    shape.batchStride = strides[0];
+    shape.channelStride = strides[1];
+    shape.boxStride = strides[2];
+    if(dims[1] > dims[2]) {
+        // Anchor-major export, [B, N, C]
+        shape.channels = dims[2];
+        shape.boxes = dims[1];
+        shape.channelStride = strides[2];
+        shape.boxStride = strides[1];
+    }
+    return shape;
+}
+
+/**
+ * @brief Letterbox that fits a srcW x srcH image into a square model input,
+ * centered and keeping the aspect ratio.
+ * @param srcW, source width
+ * @param srcH, source height
+ * @param inputSize, side of the model input
+ * @return
+ */
+YoloParser::LetterboxInfo YoloParser::letterboxFor(int srcW, int srcH, int inputSize)
+{
+    LetterboxInfo info;
+    info.origW = srcW;
+    info.origH = srcH;
+    info.inputSize = inputSize;
+    if(srcW <= 0 || srcH <= 0 || inputSize <= 0)
+        return info;
+
+    info.scale = std::min((float)inputSize / srcW,
+                          (float)inputSize / srcH);
+    const int newW = (int)(srcW * info.scale);
+    const int newH = (int)(srcH * info.scale);
+    info.padX = (inputSize - newW) / 2;
+    info.padY = (inputSize - newH) / 2;
+    return info;
+}
+
+/**
+ * @brief Collects the boxes whose best class score passes the threshold.
+ * Classes/Anchors are compile-time shapes; 0 means "use the runtime value".
+ * Class rows are scanned one at a time so the inner loop walks contiguous
+ * memory and, with a constant trip count, can be unrolled and vectorized.
+ * @param data, start of one batch item in [C, N] layout
+ * @param shape, runtime shape, used where Classes/Anchors are 0
+ * @param confThreshold, confidence threshold
+ * @param out, candidates sink
+ */
+template<int Classes, int Anchors>
+void YoloParser::collectCandidates(const float* data,
+                                   const TensorShape &shape,
+                                   float confThreshold,
+                                   Candidates &out)
+{
+    const int C = Classes > 0 ? Classes : shape.channels - 4;
+    const int N = Anchors > 0 ? Anchors : shape.boxes;
+    const qint64 rowStride = shape.strideC();
+
+    // Per-thread scratch, parse runs concurrently for each batch item
+    thread_local std::vector<float> bestScores;
+    thread_local std::vector<int> bestClasses;
+    bestScores.assign(N, -1e9f);
+    bestClasses.assign(N, -1);
+    float* best = bestScores.data();
+    int* bestClass = bestClasses.data();
+
+    const float* classRows = data + 4 * rowStride;
+    for(int c = 0; c < C; ++c) {
+        const float* row = classRows + c * rowStride;
+        for(int i = 0; i < N; ++i) {
+            const bool better = row[i] > best[i];
+            best[i] = better ? row[i] : best[i];
+            bestClass[i] = better ? c : bestClass[i];
+        }
+    }
+
+    const float* xs = data;
+    const float* ys = data + rowStride;
+    const float* ws = data + 2 * rowStride;
+    const float* hs = data + 3 * rowStride;
+    for(int i = 0; i < N; ++i) {
+        if(best[i] < confThreshold) continue;
+        //keep normalized cx/cy/w/h scaled to pixel coords (defer QRect creation)
+        out.push(xs[i], ys[i], ws[i], hs[i], best[i], bestClass[i]);
+    }
+}
+
+/**
+ * @brief Anchor-major counterpart of collectCandidates().
+ * Each box's values are contiguous, so the class scan is a plain max
+ * reduction and boxes below the threshold are dropped before the argmax
+ * search, which then stops at the first class holding the max.
+ * @param data, start of one batch item in [N, C] layout
+ * @param shape, runtime shape, used where Classes/Anchors are 0
+ * @param confThreshold, confidence threshold
+ * @param out, candidates sink
+ */
+template<int Classes, int Anchors>
+void YoloParser::collectCandidatesAnchorMajor(const float* data,
+                                              const TensorShape &shape,
+                                              float confThreshold,
+                                              Candidates &out)
+{
+    const int C = Classes > 0 ? Classes : shape.channels - 4;
+    const int N = Anchors > 0 ? Anchors : shape.boxes;
+    const qint64 boxStride = shape.strideN();
+
+    for(int i = 0; i < N; ++i) {
+        const float* box = data + i * boxStride;
+        const float* scores = box + 4;
+
+        float bestScore = -1e9f;
+        for(int c = 0; c < C; ++c)
+            bestScore = std::max(bestScore, scores[c]);
+        if(bestScore < confThreshold) continue;
+
+        int bestClass = 0;
+        while(scores[bestClass] != bestScore)
+            ++bestClass;
+
+        out.push(box[0], box[1], box[2], box[3], bestScore, bestClass);
+    }
+}
+
+/**
+ * @brief Fallback decoder for tensors that have no unit stride on either
+ * the channel or the box axis.
+ * @param data, start of one batch item
+ * @param shape, runtime shape and strides
+ * @param confThreshold, confidence threshold
+ * @param out, candidates sink
+ */
+void YoloParser::collectCandidatesStrided(const float* data,
+                                          const TensorShape &shape,
+                                          float confThreshold,
+                                          Candidates &out)
+{
+    const int classes = shape.channels - 4;
+    const qint64 sC = shape.strideC();
+    const qint64 sN = shape.strideN();
+
+    for(int i = 0; i < shape.boxes; ++i) {
+        const float* box = data + i * sN;
+
+        int bestClass = -1;
+        float bestScore = -1e9f;
+        for(int c = 0; c < classes; ++c) {
+            float v = box[(4 + c) * sC];
+            if(v > bestScore) {
+                bestScore = v;
+                bestClass = c;
+            }
+        }
+        if(bestScore < confThreshold) continue;
+
+        out.push(box[0], box[sC], box[2 * sC], box[3 * sC], bestScore, bestClass);
+    }
+}
+
+/**
+ * @brief Decoder used when the filter restricts the classes of interest.
+ * Only the allowed class rows are read; a class wins only if it passes its
+ * own threshold.
+ * @param data, start of one batch item
+ * @param shape, runtime shape and strides
+ * @param filter, class allow-list
+ * @param confThreshold, threshold for classes without their own
+ * @param out, candidates sink
+ */
+void YoloParser::collectCandidatesFiltered(const float* data,
+                                           const TensorShape &shape,
+                                           const DetectionFilter &filter,
+                                           float confThreshold,
+                                           Candidates &out)
+{
+    const int classes = shape.channels - 4;
+    const int N = shape.boxes;
+    const qint64 sC = shape.strideC();
+    const qint64 sN = shape.strideN();
+    const QVector<int> &allowed = filter.allowedClasses();
+
+    thread_local std::vector<float> bestScores;
+    thread_local std::vector<int> bestClasses;
+    bestScores.assign(N, -1e9f);
+    bestClasses.assign(N, -1);
+    float* best = bestScores.data();
+    int* bestClass = bestClasses.data();
+
+    for(int k = 0; k < allowed.size(); ++k) {
+        const int c = allowed.at(k);
+        if(c >= classes) continue;
+        const float thresh = filter.threshold(k, confThreshold);
+        const float* row = data + (4 + c) * sC;
+        if(sN == 1) {
+            for(int i = 0; i < N; ++i) {
+                const bool better = row[i] >= thresh && row[i] > best[i];
+                best[i] = better ? row[i] : best[i];
+                bestClass[i] = better ? c : bestClass[i];
+            }
+        } else {
+            for(int i = 0; i < N; ++i) {
+                const float v = row[i * sN];
+                if(v >= thresh && v > best[i]) {
+                    best[i] = v;
+                    bestClass[i] = c;
+                }
+            }
+        }
+    }
+
+    for(int i = 0; i < N; ++i) {
+        if(bestClass[i] < 0) continue;
+        const float* box = data + i * sN;
+        out.push(box[0], box[sC], box[2 * sC], box[3 * sC], best[i], bestClass[i]);
+    }
+}
+
+/**
+ * @brief Drops candidates whose center falls outside the filter's regions.
+ * @param cand, candidates, compacted in place
+ * @param letterbox, letterbox used to map centers back to the frame
+ * @param filter, region mask
+ */
+void YoloParser::applyRegions(Candidates &cand,
+                              const LetterboxInfo& letterbox,
+                              const DetectionFilter &filter)
+{
+    if(letterbox.origW <= 0 || letterbox.origH <= 0 || letterbox.scale <= 0.f)
+        return;
+
+    const float toNormX = 1.f / (letterbox.scale * letterbox.origW);
+    const float toNormY = 1.f / (letterbox.scale * letterbox.origH);
+    size_t kept = 0;
+    for(size_t i = 0; i < cand.size(); ++i) {
+        const float nx = (cand.cx[i] - letterbox.padX) * toNormX;
+        const float ny = (cand.cy[i] - letterbox.padY) * toNormY;
+        if(!filter.containsNormalized(nx, ny)) continue;
+        cand.copy(i, kept++);
+    }
+    cand.resize(kept);
+}
+
+/**
+ * @brief Keeps the maxCandidates highest scoring candidates, in anchor order.
+ * Uses partial selection so the cost stays linear in the candidate count.
+ * @param cand, candidates, compacted in place
+ * @param maxCandidates, number of candidates to keep
+ * @return number of candidates dropped
+ */
+int YoloParser::keepTopCandidates(Candidates &cand, int maxCandidates)
+{
+    const size_t K = cand.size();
+    if(maxCandidates <= 0 || K <= size_t(maxCandidates)) return 0;
+
+    std::vector<int> idxs(K);
+    std::iota(idxs.begin(), idxs.end(), 0);
+    std::nth_element(idxs.begin(), idxs.begin() + maxCandidates, idxs.end(),
+                     [&cand](int a, int b) { return cand.score[a] > cand.score[b]; });
+    idxs.resize(maxCandidates);
+    std::sort(idxs.begin(), idxs.end());
+
+    for(size_t k = 0; k < idxs.size(); ++k)
+        cand.copy(idxs[k], k);
+    cand.resize(idxs.size());
+    return int(K - idxs.size());
+}
+
+/**
+ * @brief Looks up a shape-specialized decoder.
+ * Covers 80/20/1-class models at 640 (8400 anchors) and 1280 (33600 anchors),
+ * in both channel-major and anchor-major layouts.
+ * @param shape, tensor shape
+ * @return decoder, or nullptr when the generic path must be used
+ */
+YoloParser::DecodeFn YoloParser::specializedDecoder(const TensorShape &shape)
+{
+    struct Entry {
+        TensorLayout layout;
+        int classes;
+        int boxes;
+        DecodeFn fn;
+    };
+    static const Entry decoders[] = {
+        {TensorLayout::ChannelMajor, 80,  8400, &YoloParser::collectCandidates<80,  8400>},
+        {TensorLayout::ChannelMajor, 80, 33600, &YoloParser::collectCandidates<80, 33600>},
+        {TensorLayout::ChannelMajor, 20,  8400, &YoloParser::collectCandidates<20,  8400>},
+        {TensorLayout::ChannelMajor, 20, 33600, &YoloParser::collectCandidates<20, 33600>},
+        {TensorLayout::ChannelMajor,  1,  8400, &YoloParser::collectCandidates< 1,  8400>},
+        {TensorLayout::ChannelMajor,  1, 33600, &YoloParser::collectCandidates< 1, 33600>},
+        {TensorLayout::AnchorMajor,  80,  8400, &YoloParser::collectCandidatesAnchorMajor<80,  8400>},
+        {TensorLayout::AnchorMajor,  80, 33600, &YoloParser::collectCandidatesAnchorMajor<80, 33600>},
+        {TensorLayout::AnchorMajor,  20,  8400, &YoloParser::collectCandidatesAnchorMajor<20,  8400>},
+        {TensorLayout::AnchorMajor,  20, 33600, &YoloParser::collectCandidatesAnchorMajor<20, 33600>},
+        {TensorLayout::AnchorMajor,   1,  8400, &YoloParser::collectCandidatesAnchorMajor< 1,  8400>},
+        {TensorLayout::AnchorMajor,   1, 33600, &YoloParser::collectCandidatesAnchorMajor< 1, 33600>},
+    };
+    const TensorLayout layout = shape.layout();
+    const int classes = shape.channels - 4;
+    for(const Entry &e : decoders) {
+        if(e.layout == layout && e.classes == classes && e.boxes == shape.boxes)
+            return e.fn;
+    }
+    return nullptr;
+}
+
+YoloParser::DecodeFn YoloParser::genericDecoder(const TensorShape &shape)
+{
+    switch(shape.layout()) {
+    case TensorLayout::ChannelMajor:
+        return &YoloParser::collectCandidates<0, 0>;
+    case TensorLayout::AnchorMajor:
+        return &YoloParser::collectCandidatesAnchorMajor<0, 0>;
+    case TensorLayout::Strided:
+        break;
+    }
+    return &YoloParser::collectCandidatesStrided;
+}
+
+bool YoloParser::hasSpecializedDecoder(const TensorShape &shape)
+{
+    return specializedDecoder(shape) != nullptr;
+}
+
 /**
  * @brief This function parses the YOLO output tensor to extract detections.
  * @param data, pointer to the output tensor data
@@ -127,8 +544,9 @@ std::vector<int> YoloParser::nms(const std::vector<float>& xs,
  * @param batchIndex, index of the batch to parse
  * @param confThreshold, confidence threshold
  * @param iouThreshold, IOU threshold
- * @param inputW, width of the input image
- * @param inputH, height of the input image
+ * @param filter, optional class allow-list and region mask
+ * @param limits, caps on candidates and detections
+ * @param stats, optional output for candidate and truncation counts
  * @return
  */
 QList<Detection> YoloParser::parse(
@@ -138,10 +556,43 @@ QList<Detection> YoloParser::parse(
     int batchIndex,
     float confThreshold,
     float iouThreshold,
-    int inputW,
-    int inputH)
+    const DetectionFilter *filter,
+    const DecodeLimits &limits,
+    ParseStats *stats)
+{
+    return parseImpl(data, shape, letterbox, batchIndex,
+                     confThreshold, iouThreshold, filter, limits, stats, true);
+}
+
+QList<Detection> YoloParser::parseGeneric(
+    const float* data,
+    const TensorShape &shape,
+    const LetterboxInfo& letterbox,
+    int batchIndex,
+    float confThreshold,
+    float iouThreshold,
+    const DetectionFilter *filter,
+    const DecodeLimits &limits,
+    ParseStats *stats)
+{
+    return parseImpl(data, shape, letterbox, batchIndex,
+                     confThreshold, iouThreshold, filter, limits, stats, false);
+}
+
+QList<Detection> YoloParser::parseImpl(
+    const float* data,
+    const TensorShape &shape,
+    const LetterboxInfo& letterbox,
+    int batchIndex,
+    float confThreshold,
+    float iouThreshold,
+    const DetectionFilter *filter,
+    const DecodeLimits &limits,
+    ParseStats *stats,
+    bool allowSpecialized)
 {
     QList<Detection> detections;
+    if(stats) *stats = ParseStats();
     if(!data) return detections;
     if(batchIndex < 0 || batchIndex >= shape.batch) return detections;
 
@@ -150,66 +601,78 @@ QList<Detection> YoloParser::parse(
 
     qDebug() << "Channels:" << C << "Boxes:" << N << "BatchIndex" << batchIndex;
 
-    if(C < 6) return detections; // At least x,y,w,h,obj + 1 class
-
-    const long classOffset = 4;
-    const int classes = C - 4;
+    if(C < 4 + 1) return detections; // At least x,y,w,h + 1 class, no objectness
 
     //Offset to the start of the batch
-    const int batchOffset = batchIndex * (int)(C) * (int)(N);
+    const qint64 batchOffset = qint64(batchIndex) * shape.strideB();
+
+    Candidates cand;
+    cand.reserve(256);
+    if(filter && filter->hasClassFilter()) {
+        collectCandidatesFiltered(data + batchOffset, shape, *filter, confThreshold, cand);
+    } else {
+        DecodeFn decode = allowSpecialized ? specializedDecoder(shape) : nullptr;
+        if(!decode)
+            decode = genericDecoder(shape);
+        decode(data + batchOffset, shape, confThreshold, cand);
+    }
 
-    std::vector<float> cand_cx; cand_cx.reserve(256);
-    std::vector<float> cand_cy; cand_cy.reserve(256);
-    std::vector<float> cand_w;  cand_w .reserve(256);
-    std::vector<float> cand_h;  cand_h .reserve(256);
-    std::vector<float> cand_score; cand_score.reserve(256);
-    std::vector<int> cand_class; cand_class.reserve(256);
+    if(filter && filter->hasRegions())
+        applyRegions(cand, letterbox, *filter);
 
-    for(int i = 0; i < N; ++i) {
-        float cx = data[batchOffset + 0*N + i];
-        float cy = data[batchOffset + 1*N + i];
-        float w  = data[batchOffset + 2*N + i];
-        float h  = data[batchOffset + 3*N + i];
+    ParseStats localStats;
+    ParseStats &st = stats ? *stats : localStats;
+    st.candidates = int(cand.size());
 
-        // Find best class
-        int bestClass = -1;
-        float bestScore = -1e9f;
-        for(int c = 0; c < classes; c++) {
-            float v = data[batchOffset + (classOffset+c)*N + i];
-            if (v > bestScore) {
-                bestScore = v;
-                bestClass = c;
-            }
-        }
+    if(cand.empty()) return detections;
 
-        if(bestScore < confThreshold) continue;
+    st.truncatedCandidates += keepTopCandidates(cand, limits.maxCandidates);
 
-        //keep normalized cx/cy/w/h scaled to pixel coords (defer QRect creation)
-        cand_cx.push_back(cx);
-        cand_cy.push_back(cy);
-        cand_w .push_back(w);
-        cand_h .push_back(h);
-        cand_score.push_back(bestScore);
-        cand_class.push_back(bestClass);
-    }
+    return buildDetections(cand, letterbox, iouThreshold, limits, st);
+}
 
-    if(cand_score.empty()) return detections;
+/**
+ * @brief Runs class-wise NMS over the candidates and maps them back to the
+ * original frame.
+ * @param cand, candidates collected from the tensor
+ * @param letterbox, letterbox applied to the source frame
+ * @param iouThreshold, IOU threshold
+ * @param limits, per-class candidate cap and detection cap
+ * @param stats, truncation counters
+ * @return
+ */
+QList<Detection> YoloParser::buildDetections(const Candidates &cand,
+                                             const LetterboxInfo& letterbox,
+                                             float iouThreshold,
+                                             const DecodeLimits &limits,
+                                             ParseStats &stats)
+{
+    QList<Detection> detections;
 
     // Now perform class-wise grouping and NMS
     // Build maps of indexes per class
     std::unordered_map<int, std::vector<int>> classBuckets;
     classBuckets.reserve(16);
-    const int K = static_cast<int>(cand_score.size());
+    const int K = static_cast<int>(cand.size());
     //Group indices by class
 
     for(int i = 0; i < K; ++i)
-        classBuckets[cand_class[i]].push_back(i);
+        classBuckets[cand.classId[i]].push_back(i);
 
     //For each class, perform NMS
-    for (const auto& kv : classBuckets) {
-        const std::vector<int>& indexes = kv.second;
+    for (auto& kv : classBuckets) {
+        std::vector<int>& indexes = kv.second;
         if(indexes.empty()) continue;
 
+        // Bound the quadratic NMS to the best maxCandidatesPerClass boxes
+        const int perClass = limits.maxCandidatesPerClass;
+        if(perClass > 0 && indexes.size() > size_t(perClass)) {
+            std::nth_element(indexes.begin(), indexes.begin() + perClass, indexes.end(),
+                             [&cand](int a, int b) { return cand.score[a] > cand.score[b]; });
+            stats.truncatedCandidates += int(indexes.size()) - perClass;
+            indexes.resize(perClass);
+        }
+
         std::vector<float> xs, ys, ws, hs, ss;
         xs.reserve(indexes.size());
         ys.reserve(indexes.size());
@@ -217,20 +680,20 @@ QList<Detection> YoloParser::parse(
         hs .reserve(indexes.size());
         ss .reserve(indexes.size());
         for(int idx : indexes) {
-            xs.push_back(cand_cx[idx]);
-            ys.push_back(cand_cy[idx]);
-            ws.push_back(cand_w [idx]);
-            hs.push_back(cand_h [idx]);
-            ss.push_back(cand_score[idx]);
+            xs.push_back(cand.cx[idx]);
+            ys.push_back(cand.cy[idx]);
+            ws.push_back(cand.w [idx]);
+            hs.push_back(cand.h [idx]);
+            ss.push_back(cand.score[idx]);
         }
         std::vector<int> keep = nms(xs, ys, ws, hs, ss, iouThreshold);
         for(int k : keep) {
             int id = indexes[k];
 
-            float x = (cand_cx[id] - cand_w[id]/2.f - letterbox.padX) / letterbox.scale;
-            float y = (cand_cy[id] - cand_h[id]/2.f - letterbox.padY) / letterbox.scale;
-            float bw = cand_w[id] / letterbox.scale;
-            float bh = cand_h[id] / letterbox.scale;
+            float x = (cand.cx[id] - cand.w[id]/2.f - letterbox.padX) / letterbox.scale;
+            float y = (cand.cy[id] - cand.h[id]/2.f - letterbox.padY) / letterbox.scale;
+            float bw = cand.w[id] / letterbox.scale;
+            float bh = cand.h[id] / letterbox.scale;
 
             x = std::clamp(x, 0.f, float(letterbox.origW - 1));
             y =  std::clamp(y, 0.f, float(letterbox.origH - 1));
@@ -248,13 +711,13 @@ QList<Detection> YoloParser::parse(
                 continue;
 
             Detection det;
-            det.classId = cand_class[id];
+            det.classId = cand.classId[id];
             det.rect = QRect(int(x),
                              int(y),
                              int(finalW),
                              int(finalH));
-            det.label = YOLO_CLASSES.value(cand_class[id], "unknown");
-            det.score = cand_score[id];
+            det.label = YOLO_CLASSES.value(cand.classId[id], "unknown");
+            det.score = cand.score[id];
             det.origW = letterbox.origW;
             det.origH = letterbox.origH;
             qWarning() << "detection:"
@@ -268,79 +731,169 @@ QList<Detection> YoloParser::parse(
         }
     }
 
+    const int maxDetections = limits.maxDetections;
+    if(maxDetections > 0 && detections.size() > maxDetections) {
+        std::nth_element(detections.begin(), detections.begin() + maxDetections, detections.end(),
+                         [](const Detection &a, const Detection &b) { return a.score > b.score; });
+        stats.truncatedDetections = int(detections.size()) - maxDetections;
+        detections.resize(maxDetections);
+    }
+
     return detections;
 }
 
 /**
- * @brief This function parses a batch of YOLO outputs.
- * @param blob, byte array containing the output tensor data
- * @param batchCount, number of batches
- * @param channels, number of channels
- * @param boxes, number of boxes
+ * @brief Checks a raw batch before it is parsed, logging why it is rejected.
  */
-void YoloParser::parseBatch(const QByteArray& blob,
-                            int batchCount,
-                            int channels,
-                            int boxes,
-                            QVector<LetterboxInfo> letterboxInfo)
+bool YoloParser::isValidBatch(const QByteArray &blob,
+                              const TensorShape &shape,
+                              const QVector<LetterboxInfo> &letterboxInfo)
 {
-    if (channels < 6 || channels > 512) {
+    const int batchCount = shape.batch;
+    const int channels = shape.channels;
+    const int boxes = shape.boxes;
+
+    if (channels < 4 + 1 || channels > 512) {
         qWarning() << "Invalid channel count:" << channels;
-        return;
+        return false;
     }
 
-    if (boxes <= 0 || boxes > 20000) {
+    // 1280 inputs produce 33600 anchors
+    if (boxes <= 0 || boxes > 40000) {
         qWarning() << "Invalid box count:" << boxes;
-        return;
+        return false;
     }
 
     if (batchCount <= 0 || batchCount > 4) {
         qWarning() << "Invalid batch count:" << batchCount;
-        return;
+        return false;
     }
     if(letterboxInfo.size() < batchCount) {
         qWarning() << "YoloParser::parseBatch letterboxInfo size"
                    << letterboxInfo.size()
                    << "less than batchCount" << batchCount;
-        return;
+        return false;
     }
     qDebug() << "ParseBatch Batch:" << batchCount << "Channels:" << channels << "Boxes:" << boxes;
     if(blob.isEmpty()) {
         qWarning() << "YoloParser::parseBatch received empty blob!";
-        return;
+        return false;
     }
-    if (letterboxInfo.size() < batchCount) {
-        qWarning() << "letterboxInfo size mismatch"
-                   << letterboxInfo.size()
-                   << "batchCount" << batchCount;
+    if (qint64(blob.size()) < shape.extent() * qint64(sizeof(float))) {
+        qWarning() << "YoloParser::parseBatch blob too small for shape"
+                   << blob.size() << "bytes";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief This function parses a batch of YOLO outputs.
+ * @param blob, byte array containing the output tensor data
+ * @param shape, shape and strides of the tensor held by blob
+ * @param letterboxInfo, letterbox applied to each batch item
+ * @param sources, full-resolution frames for the crop stage, may be empty
+ */
+void YoloParser::parseBatch(const QByteArray& blob,
+                            TensorShape shape,
+                            QVector<LetterboxInfo> letterboxInfo,
+                            QList<CropSource> sources)
+{
+    if (!isValidBatch(blob, shape, letterboxInfo)) {
+        emit parsingFinished(0.0);
         return;
     }
-    const float * data = reinterpret_cast<const float*>(blob.constData());
-    TensorShape shape {batchCount, channels, boxes};
-    qDebug() << "Shape Batch:" << shape.batch << "Channels:" << shape.channels << "Boxes:" << shape.boxes;
-
-    auto startParse = std::chrono::high_resolution_clock::now();
-
-    QFuture<QList<Detection>> futureDetections0 = QtConcurrent::run([=]() {
-        return YoloParser::parse(data, shape, letterboxInfo.at(0), 0);
-    });
-    QFuture<QList<Detection>> futureDetections1;
-    if(batchCount > 1) {
-        futureDetections1 = QtConcurrent::run([=]() {
-            return YoloParser::parse(data, shape, letterboxInfo.at(1), 1);
+    const int batchCount = shape.batch;
+    qDebug() << "Shape Batch:" << shape.batch << "Channels:" << shape.channels << "Boxes:" << shape.boxes
+             << "Layout:" << int(shape.layout());
+
+    auto job = std::make_shared<BatchJob>();
+    job->blob = blob;
+    job->shape = shape;
+    job->letterboxInfo = letterboxInfo;
+    job->sources = sources;
+    job->filter = m_filter;
+    job->limits = m_limits;
+    job->detections.resize(batchCount);
+    job->stats.resize(batchCount);
+    job->remaining = batchCount;
+    job->start = std::chrono::high_resolution_clock::now();
+
+    for(int b = 0; b < batchCount; ++b) {
+        m_tasks.run([this, job, b]() {
+            const float *data = reinterpret_cast<const float*>(job->blob.constData());
+            const LetterboxInfo &letterbox = job->letterboxInfo.at(b);
+            job->detections[b] = YoloParser::parse(data, job->shape, letterbox, b,
+                                                   CONF_THRESH, IOU_THRESH,
+                                                   &job->filter, job->limits, &job->stats[b]);
+            if(job->remaining.fetch_sub(1) != 1)
+                return;
+
+            auto endParse = std::chrono::high_resolution_clock::now();
+            job->ms = std::chrono::duration<double, std::milli>(endParse - job->start).count();
+            // Back to the parser's thread, the mailbox's only writer
+            QMetaObject::invokeMethod(this, [this, job]() { finishBatch(*job); },
+                                      Qt::QueuedConnection);
         });
     }
+}
+
+/**
+ * @brief Publishes a parsed batch. The items of a batch are consecutive
+ * frames of the same camera and the mailbox only keeps the latest value,
+ * so only the newest item is published; the older ones still reach the
+ * crop stage.
+ */
+void YoloParser::finishBatch(const BatchJob &job)
+{
+    const int last = int(job.detections.size()) - 1;
+    publish(last, job.ms, job.detections[last]);
+
+    if(m_cropStage && !job.sources.isEmpty())
+        m_cropStage->submit(job.sources, job.detections);
+
+    emit parsingFinished(job.ms);
+
+    int truncated = 0;
+    for(const ParseStats &stats : job.stats)
+        truncated += stats.truncatedCandidates + stats.truncatedDetections;
+    emit candidatesTruncated(truncated);
+}
+
+/**
+ * @brief Hands a result to the stream's mailbox, replacing any result the
+ * consumer has not picked up yet.
+ */
+void YoloParser::publish(int batchIndex, double parseMs, const QList<Detection> &detections)
+{
+    if(!m_mailbox) return;
+    DetectionFrame &frame = m_mailbox->writeBuffer();
+    frame.sequence = ++m_sequence;
+    frame.batchIndex = batchIndex;
+    frame.parseMs = parseMs;
+    frame.detections = detections;
+    m_mailbox->publish();
+}
 
-    QList<Detection> det0 = futureDetections0.result();
-    QList<Detection> det1;
-    if(batchCount > 1)
-        det1 = futureDetections1.result();
+/**
+ * @brief Sets the class allow-list and regions used by parseBatch.
+ * @param filter, new filter, an empty one disables filtering
+ */
+void YoloParser::setDetectionFilter(const DetectionFilter &filter)
+{
+    m_filter = filter;
+}
 
-    auto endParse = std::chrono::high_resolution_clock::now();
-    double ms = std::chrono::duration<double, std::milli>(endParse - startParse).count();
-    emit parsingFinished(ms);
+/**
+ * @brief Sets the candidate and detection caps used by parseBatch.
+ * @param limits
+ */
+void YoloParser::setDecodeLimits(const DecodeLimits &limits)
+{
+    m_limits = limits;
+}
 
-    emit detectionsReady(0, det0);
-    if(batchCount > 1)
-        emit detectionsReady(1, det1);
+void YoloParser::setCropStage(std::shared_ptr<CropStage> stage)
+{
+    m_cropStage = std::move(stage);
 }
@@ -29,36 +29,90 @@
 #include <QThread>
 
 #include "../helpers/detection.h"
+#include "cropsource.h"
+#include "detectionfilter.h"
+#include "detectionmailbox.h"
+#include "executor.h"
+
+#include <memory>
 
 constexpr float CONF_THRESH = 0.45f;
 constexpr float IOU_THRESH  = 0.45f;
 constexpr int INPUT_W = 640;
 constexpr int INPUT_H = 640;
+constexpr int MAX_CANDIDATES = 2048;
+constexpr int MAX_CANDIDATES_PER_CLASS = 512;
+constexpr int MAX_DETECTIONS = 300;
+
+class CropStage;
+
+// Upper bounds that give parse() a hard worst case in dense frames
+struct DecodeLimits {
+    int maxCandidates = MAX_CANDIDATES;                  // kept before NMS, all classes
+    int maxCandidatesPerClass = MAX_CANDIDATES_PER_CLASS; // kept before NMS, per class
+    int maxDetections = MAX_DETECTIONS;                  // kept after NMS
+};
+
+struct ParseStats {
+    int candidates = 0;             // boxes above threshold
+    int truncatedCandidates = 0;    // dropped by the candidate caps
+    int truncatedDetections = 0;    // dropped by maxDetections
+};
 
 class YoloParser : public QObject
 {
     Q_OBJECT
 public:
-    explicit YoloParser(QObject *parent = nullptr);
+    // Results of parseBatch are published into mailbox, the parser being
+    // its only writer.
+    explicit YoloParser(std::shared_ptr<DetectionMailbox> mailbox = nullptr,
+                        QObject *parent = nullptr);
     ~YoloParser() {
         qWarning() << "YoloParser destroyed in thread"
                    << QThread::currentThread();
+        m_tasks.wait();
+    };
+
+    enum class TensorLayout {
+        ChannelMajor,   // [B, C, N], each channel row is contiguous
+        AnchorMajor,    // [B, N, C], each box's C values are contiguous
+        Strided         // anything else, decoded element by element
     };
 
     struct TensorShape {
         int batch;
         int channels;
         int boxes;
+        // Element strides. 0 means dense channel-major [B, C, N].
+        qint64 batchStride = 0;
+        qint64 channelStride = 0;
+        qint64 boxStride = 0;
+
+        qint64 strideB() const { return batchStride ? batchStride : qint64(channels) * boxes; }
+        qint64 strideC() const { return channelStride ? channelStride : boxes; }
+        qint64 strideN() const { return boxStride ? boxStride : 1; }
+        TensorLayout layout() const;
+        // Number of floats spanned by the tensor, including stride padding
+        qint64 extent() const;
     };
 
+    // Builds a shape from a rank-3 output tensor's dims and element strides.
+    // Both [B, C, N] and [B, N, C] exports are accepted; the box axis is
+    // assumed to be the larger one.
+    static TensorShape shapeFromTensor(const int dims[3], const qint64 strides[3]);
+
     struct LetterboxInfo {
         float scale = 1.f;
         int padX = 0;
         int padY = 0;
         int origW = 0;
         int origH = 0;
+        int inputSize = INPUT_W;    // side of the square model input
     };
 
+    // Scale and padding that fit a srcW x srcH image into the model input
+    static LetterboxInfo letterboxFor(int srcW, int srcH, int inputSize = INPUT_W);
+
     QList<Detection> decodeDetections(
         const float* data,
         const TensorShape &shape,
@@ -73,23 +127,112 @@ public:
         int batchIndex,
         float confThreshold = CONF_THRESH,
         float iouThreshold  = IOU_THRESH,
-        int inputW = INPUT_W,
-        int inputH = INPUT_H);
+        const DetectionFilter *filter = nullptr,
+        const DecodeLimits &limits = DecodeLimits(),
+        ParseStats *stats = nullptr);
 
-    // Parse a batch of YOLO outputs
-    // NOTE: parseBatch WILL take the ownership of dataPtr and will free() it.
+    // Same as parse() but always runs the runtime-shaped decoder, skipping
+    // the compile-time specializations. Kept public for benchmarking.
+    static QList<Detection> parseGeneric(
+        const float* data,
+        const TensorShape &shape,
+        const LetterboxInfo& letterbox,
+        int batchIndex,
+        float confThreshold = CONF_THRESH,
+        float iouThreshold  = IOU_THRESH,
+        const DetectionFilter *filter = nullptr,
+        const DecodeLimits &limits = DecodeLimits(),
+        ParseStats *stats = nullptr);
+
+    // True when parse() has a shape-specialized decoder for this tensor
+    static bool hasSpecializedDecoder(const TensorShape &shape);
+
+    // Parse a batch of YOLO outputs laid out as described by shape. The
+    // items are decoded on the executor's parse pool; results are published
+    // and signalled from the parser's own thread once all are done.
+    // Sources, one per item, are held until then and handed to the crop
+    // stage with the detections.
     void parseBatch(const QByteArray& data,
-                    int batchCount,
-                    int channels,
-                    int boxes,
-                    QVector<LetterboxInfo> letterboxInfo);
+                    YoloParser::TensorShape shape,
+                    QVector<LetterboxInfo> letterboxInfo,
+                    QList<CropSource> sources = QList<CropSource>());
+
+    // Replaces the filter applied to every frame parsed from now on
+    void setDetectionFilter(const DetectionFilter &filter);
+    void setDecodeLimits(const DecodeLimits &limits);
+    // Receives every parsed batch that came with sources. Set it before the
+    // parser is moved to its thread.
+    void setCropStage(std::shared_ptr<CropStage> stage);
 
     static const QStringList YOLO_CLASSES;
 
 signals:
-    void detectionsReady(int batchIndex, QList<Detection> detections);
+    // Emitted once per parseBatch() call, with 0 ms for rejected batches,
+    // so owners waiting on a batch always get their frames back
     void parsingFinished(double ms);
+    // Candidates and detections dropped by the caps, summed over the batch
+    void candidatesTruncated(int count);
 private:
+    struct Candidates;
+    struct BatchJob;
+    using DecodeFn = void (*)(const float* data,
+                              const TensorShape &shape,
+                              float confThreshold,
+                              Candidates &out);
+
+    template<int Classes, int Anchors>
+    static void collectCandidates(const float* data,
+                                  const TensorShape &shape,
+                                  float confThreshold,
+                                  Candidates &out);
+    template<int Classes, int Anchors>
+    static void collectCandidatesAnchorMajor(const float* data,
+                                             const TensorShape &shape,
+                                             float confThreshold,
+                                             Candidates &out);
+    static void collectCandidatesStrided(const float* data,
+                                         const TensorShape &shape,
+                                         float confThreshold,
+                                         Candidates &out);
+    static void collectCandidatesFiltered(const float* data,
+                                          const TensorShape &shape,
+                                          const DetectionFilter &filter,
+                                          float confThreshold,
+                                          Candidates &out);
+    static void applyRegions(Candidates &cand,
+                             const LetterboxInfo& letterbox,
+                             const DetectionFilter &filter);
+    static DecodeFn specializedDecoder(const TensorShape &shape);
+    static DecodeFn genericDecoder(const TensorShape &shape);
+    static QList<Detection> parseImpl(const float* data,
+                                      const TensorShape &shape,
+                                      const LetterboxInfo& letterbox,
+                                      int batchIndex,
+                                      float confThreshold,
+                                      float iouThreshold,
+                                      const DetectionFilter *filter,
+                                      const DecodeLimits &limits,
+                                      ParseStats *stats,
+                                      bool allowSpecialized);
+    static int keepTopCandidates(Candidates &cand, int maxCandidates);
+    static QList<Detection> buildDetections(const Candidates &cand,
+                                            const LetterboxInfo& letterbox,
+                                            float iouThreshold,
+                                            const DecodeLimits &limits,
+                                            ParseStats &stats);
+
+    std::shared_ptr<DetectionMailbox> m_mailbox;
+    quint64 m_sequence = 0;
+    DetectionFilter m_filter;
+    DecodeLimits m_limits;
+    std::shared_ptr<CropStage> m_cropStage;
+
+    void publish(int batchIndex, double parseMs, const QList<Detection> &detections);
+    void finishBatch(const BatchJob &job);
+    static bool isValidBatch(const QByteArray &blob,
+                             const TensorShape &shape,
+                             const QVector<LetterboxInfo> &letterboxInfo);
+
     static float sigmoid(float x);
     static float iou(float ax, float ay, float aw, float ah,
               float bx, float by, float bw, float bh);
@@ -99,10 +242,16 @@ private:
                          const std::vector<float>& hs,
                          const std::vector<float>& scores,
                          float iouThreshold);
+
+    // Last member, so in-flight batch items finish before anything they
+    // use is destroyed
+    TaskGroup m_tasks;
 };
 
 Q_DECLARE_METATYPE(Detection)
 Q_DECLARE_METATYPE(QList<Detection>)
 Q_DECLARE_METATYPE(YoloParser::LetterboxInfo)
+Q_DECLARE_METATYPE(YoloParser::TensorShape)
+Q_DECLARE_METATYPE(DecodeLimits)
 
 #endif // YOLOPARSER_H
@@ -0,0 +1,619 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../model/asyncdetector.h"
+#include "../model/executor.h"
+
+// Multi-stream saturation benchmark. Synthetic cameras push frames at a
+// fixed rate through the real preprocess, batching and parse stages of
+// ObjectDetectorCore; inference is a stand-in with a configurable latency
+// model. The stream count is stepped up until frames are dropped or the
+// end-to-end p99 leaves the budget, and every level is written as JSON so
+// runs of different builds can be diffed. Not registered with ctest apart
+// from a short smoke run.
+
+using Clock = DetectionClock;
+
+static double msBetween(Clock::time_point from, Clock::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+struct LatencyModel {
+    double fixedMs = 4.0;       // per inference call
+    double perItemMs = 6.0;     // per batch item, at a 640 input
+    double jitter = 0.1;        // relative standard deviation
+};
+
+struct BenchConfig {
+    int width = 1920;
+    int height = 1080;
+    double fps = 30.0;
+    int streamsStart = 1;
+    int streamsStep = 1;
+    int maxStreams = 64;
+    double durationS = 5.0;
+    double warmupS = 1.0;
+    int inputSize = INPUT_W;
+    QList<int> batchSizes {1, 2, 4};
+    LatencyModel latency;
+    int boxes = 10;                 // detections in every synthetic output
+    int maxInFlight = 2;            // per stream, newer frames are dropped
+    int maxQueue = 64;
+    int batchWindowUs = 2000;
+    double deadlineFrames = 3.0;    // queued frames older than this expire
+    double dropThreshold = 0.01;
+    double latencyBudgetMs = 0.0;   // end-to-end p99; 0 means 3 frame periods
+    QString label;
+
+    double periodMs() const { return 1000.0 / fps; }
+    double budgetMs() const { return latencyBudgetMs > 0.0 ? latencyBudgetMs : 3.0 * periodMs(); }
+};
+
+/**
+ * Inference stand-in. Sleeps for the modelled latency, as an accelerator
+ * would, and returns a YOLO-shaped [B, 84, N] tensor with a fixed set of
+ * boxes so that parsing costs what it does on real output.
+ */
+class SyntheticBackend : public InferenceBackend
+{
+public:
+    SyntheticBackend(const BenchConfig &config)
+        : m_inputSize(config.inputSize)
+        , m_batchSizes(config.batchSizes)
+        , m_latency(config.latency)
+        , m_rng(7)
+    {
+        const int side = m_inputSize;
+        m_anchors = (side / 8) * (side / 8) + (side / 16) * (side / 16) + (side / 32) * (side / 32);
+        m_item.assign(size_t(CHANNELS) * m_anchors, 0.f);
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> pos(0.1f * side, 0.9f * side);
+        std::uniform_real_distribution<float> extent(0.02f * side, 0.2f * side);
+        for(int i = 0; i < config.boxes && i < m_anchors; ++i) {
+            const int n = int((qint64(i) * 7919) % m_anchors);
+            m_item[0 * size_t(m_anchors) + n] = pos(rng);
+            m_item[1 * size_t(m_anchors) + n] = pos(rng);
+            m_item[2 * size_t(m_anchors) + n] = extent(rng);
+            m_item[3 * size_t(m_anchors) + n] = extent(rng);
+            m_item[(4 + i % 80) * size_t(m_anchors) + n] = 0.9f;
+        }
+    }
+
+    bool load(QString *) override { return true; }
+    bool compile(QString *) override { return true; }
+
+    bool infer(const float *input, int batch, InferenceOutput &output, QString *error) override {
+        if(!input || batch <= 0) {
+            if(error) *error = "empty batch";
+            return false;
+        }
+        const double scale = double(m_inputSize) * m_inputSize / (double(INPUT_W) * INPUT_W);
+        double ms = m_latency.fixedMs + m_latency.perItemMs * batch * scale;
+        {
+            std::lock_guard<std::mutex> lock(m_rngMutex);
+            std::normal_distribution<double> noise(1.0, m_latency.jitter);
+            ms *= std::max(0.0, noise(m_rng));
+        }
+        const auto until = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                               std::chrono::duration<double, std::milli>(ms));
+        std::this_thread::sleep_until(until);
+
+        const size_t itemBytes = m_item.size() * sizeof(float);
+        output.shape = {batch, CHANNELS, m_anchors};
+        output.data = QByteArray(qsizetype(itemBytes) * batch, Qt::Uninitialized);
+        for(int b = 0; b < batch; ++b)
+            std::memcpy(output.data.data() + b * itemBytes, m_item.data(), itemBytes);
+        return true;
+    }
+
+    QList<int> supportedBatchSizes() const override { return m_batchSizes; }
+    int inputSize() const override { return m_inputSize; }
+
+private:
+    static constexpr int CHANNELS = 84;
+
+    int m_inputSize;
+    QList<int> m_batchSizes;
+    LatencyModel m_latency;
+    int m_anchors = 0;
+    std::vector<float> m_item;
+    std::mutex m_rngMutex;
+    std::mt19937 m_rng;
+};
+
+// Samples of one pipeline stage at one load level
+class StageSamples
+{
+public:
+    void add(double ms) {
+        m_samples.push_back(ms);
+        m_sorted = false;
+    }
+
+    QJsonObject toJson() {
+        QJsonObject json;
+        json["count"] = qint64(m_samples.size());
+        if(m_samples.empty())
+            return json;
+        double total = 0.0;
+        for(double ms : m_samples) total += ms;
+        json["mean"] = total / m_samples.size();
+        json["p50"] = percentile(0.50);
+        json["p99"] = percentile(0.99);
+        json["p999"] = percentile(0.999);
+        json["max"] = percentile(1.0);
+        return json;
+    }
+
+    // Nearest rank
+    double percentile(double q) {
+        if(m_samples.empty()) return 0.0;
+        if(!m_sorted) {
+            std::sort(m_samples.begin(), m_samples.end());
+            m_sorted = true;
+        }
+        const size_t rank = size_t(std::ceil(q * m_samples.size()));
+        return m_samples[std::clamp<size_t>(rank, 1, m_samples.size()) - 1];
+    }
+
+private:
+    std::vector<double> m_samples;
+    bool m_sorted = true;
+};
+
+struct LevelResult {
+    int streams = 0;
+    double seconds = 0.0;
+    quint64 offered = 0;
+    quint64 completed = 0;
+    quint64 droppedInFlight = 0;    // stream already had maxInFlight frames
+    quint64 rejected = 0;           // detector queue full
+    quint64 expired = 0;            // deadline passed while queued
+    quint64 failed = 0;
+    double avgBatchSize = 0.0;
+    StageSamples preprocess;        // capture to submit, letterbox and pool wait
+    StageSamples queue;
+    StageSamples infer;
+    StageSamples parse;
+    StageSamples endToEnd;          // capture to result
+    QJsonObject pools;
+    bool saturated = false;
+
+    quint64 dropped() const { return droppedInFlight + rejected + expired; }
+    double dropRate() const { return offered ? double(dropped()) / offered : 0.0; }
+};
+
+/**
+ * One load level: N synthetic streams for warmup + duration seconds.
+ * Producers only stamp and hand frames to the preprocess pool, like a
+ * camera callback; a collector thread picks up the results.
+ */
+class LoadLevel
+{
+public:
+    LoadLevel(const BenchConfig &config, int streams,
+              const std::vector<std::vector<uchar>> &frames)
+        : m_config(config)
+        , m_streams(streams)
+        , m_frames(frames)
+        , m_inFlight(size_t(streams))
+    {
+        for(auto &count : m_inFlight) count = 0;
+    }
+
+    LevelResult run()
+    {
+        LevelResult result;
+        result.streams = m_streams;
+
+        auto backend = std::make_shared<SyntheticBackend>(m_config);
+        AsyncDetector::Options options;
+        options.maxQueue = m_config.maxQueue;
+        options.batchWindow = std::chrono::microseconds(m_config.batchWindowUs);
+        AsyncDetector detector(backend, options);
+        WorkerPool *preprocess = Executor::instance().pool(Executor::PREPROCESS);
+        TaskGroup tasks(preprocess);
+
+        const QList<PoolStats> poolsBefore = Executor::instance().stats();
+        const auto start = Clock::now();
+        m_measureFrom = start + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double>(m_config.warmupS));
+        m_end = m_measureFrom + std::chrono::duration_cast<Clock::duration>(
+                                    std::chrono::duration<double>(m_config.durationS));
+
+        std::thread collector([this, &result]() { collect(result); });
+        std::vector<std::thread> producers;
+        for(int s = 0; s < m_streams; ++s)
+            producers.emplace_back([this, s, &detector, &tasks]() { produce(s, detector, tasks); });
+        for(auto &producer : producers)
+            producer.join();
+        tasks.wait();
+        {
+            QMutexLocker lock(&m_mutex);
+            m_producing = false;
+            m_wake.wakeAll();
+        }
+        collector.join();
+
+        result.seconds = m_config.durationS;
+        result.offered = m_offered.load();
+        result.droppedInFlight = m_droppedInFlight.load();
+
+        const AsyncDetector::Stats stats = detector.stats();
+        result.avgBatchSize = stats.batches ? double(stats.batchedRequests) / stats.batches : 0.0;
+        result.pools = poolUtilization(poolsBefore, Executor::instance().stats(),
+                                       msBetween(start, Clock::now()));
+        result.saturated = result.dropRate() > m_config.dropThreshold ||
+                           result.endToEnd.percentile(0.99) > m_config.budgetMs();
+        return result;
+    }
+
+private:
+    struct InFlight {
+        int stream = 0;
+        Clock::time_point captured;
+        bool measured = false;
+        double preprocessMs = 0.0;
+        std::future<DetectionResult> result;
+    };
+
+    const BenchConfig &m_config;
+    int m_streams;
+    const std::vector<std::vector<uchar>> &m_frames;
+    std::vector<std::atomic<int>> m_inFlight;
+    Clock::time_point m_measureFrom;
+    Clock::time_point m_end;
+    std::atomic<quint64> m_offered{0};
+    std::atomic<quint64> m_droppedInFlight{0};
+
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::deque<InFlight> m_pending;
+    bool m_producing = true;
+
+    void produce(int stream, AsyncDetector &detector, TaskGroup &tasks)
+    {
+        const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(m_config.periodMs()));
+        // Spread the streams over one period instead of firing together
+        auto next = Clock::now() + period * stream / std::max(1, m_streams);
+        for(quint64 frame = 0; ; ++frame, next += period) {
+            std::this_thread::sleep_until(next);
+            const auto captured = Clock::now();
+            if(captured >= m_end)
+                return;
+            const bool measured = captured >= m_measureFrom;
+            if(measured)
+                ++m_offered;
+            if(m_inFlight[size_t(stream)].load() >= m_config.maxInFlight) {
+                if(measured)
+                    ++m_droppedInFlight;
+                continue;
+            }
+            ++m_inFlight[size_t(stream)];
+
+            const std::vector<uchar> &pixels = m_frames[size_t(stream + frame) % m_frames.size()];
+            tasks.run([this, stream, captured, measured, &pixels, &detector]() {
+                DetectionRequest request = DetectionRequest::fromRgb(
+                    pixels.data(), m_config.width, m_config.height,
+                    m_config.width * 3, m_config.inputSize);
+                request.deadline = captured + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double, std::milli>(m_config.deadlineFrames * m_config.periodMs()));
+
+                InFlight item;
+                item.stream = stream;
+                item.captured = captured;
+                item.measured = measured;
+                item.preprocessMs = msBetween(captured, Clock::now());
+                item.result = detector.submit(std::move(request)).result;
+
+                QMutexLocker lock(&m_mutex);
+                m_pending.push_back(std::move(item));
+                m_wake.wakeAll();
+            });
+        }
+    }
+
+    // Polls the in-flight futures; the oldest one is waited on so that
+    // completion times are only off by the short poll interval
+    void collect(LevelResult &result)
+    {
+        std::vector<InFlight> items;
+        for(;;) {
+            {
+                QMutexLocker lock(&m_mutex);
+                while(m_pending.empty() && items.empty() && m_producing)
+                    m_wake.wait(&m_mutex);
+                while(!m_pending.empty()) {
+                    items.push_back(std::move(m_pending.front()));
+                    m_pending.pop_front();
+                }
+                if(items.empty() && !m_producing)
+                    return;
+            }
+            if(items.empty())
+                continue;
+
+            items.front().result.wait_for(std::chrono::microseconds(200));
+            for(auto it = items.begin(); it != items.end();) {
+                if(it->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                    ++it;
+                    continue;
+                }
+                const auto done = Clock::now();
+                const DetectionResult detection = it->result.get();
+                --m_inFlight[size_t(it->stream)];
+                if(it->measured)
+                    record(result, *it, detection, done);
+                it = items.erase(it);
+            }
+        }
+    }
+
+    void record(LevelResult &result, const InFlight &item,
+                const DetectionResult &detection, Clock::time_point done)
+    {
+        switch(detection.status) {
+        case DetectionResult::Status::Ok:
+            ++result.completed;
+            result.preprocess.add(item.preprocessMs);
+            result.queue.add(detection.queueMs);
+            result.infer.add(detection.inferMs);
+            result.parse.add(detection.parseMs);
+            result.endToEnd.add(msBetween(item.captured, done));
+            break;
+        case DetectionResult::Status::Rejected:
+            ++result.rejected;
+            break;
+        case DetectionResult::Status::DeadlineExceeded:
+            ++result.expired;
+            break;
+        case DetectionResult::Status::Cancelled:
+        case DetectionResult::Status::Failed:
+            ++result.failed;
+            break;
+        }
+    }
+
+    static QJsonObject poolUtilization(const QList<PoolStats> &before,
+                                       const QList<PoolStats> &after,
+                                       double elapsedMs)
+    {
+        QJsonObject pools;
+        for(const PoolStats &pool : after) {
+            double busyMs = pool.busyMs;
+            for(const PoolStats &previous : before) {
+                if(previous.name == pool.name)
+                    busyMs -= previous.busyMs;
+            }
+            const double capacity = elapsedMs * std::max(1, pool.threads);
+            pools[pool.name] = capacity > 0.0 ? busyMs / capacity : 0.0;
+        }
+        return pools;
+    }
+};
+
+// Gradient frames, so letterboxing reads real, varying pixels
+static std::vector<std::vector<uchar>> makeFrames(int width, int height, int count)
+{
+    std::vector<std::vector<uchar>> frames(static_cast<size_t>(count));
+    for(int f = 0; f < count; ++f) {
+        std::vector<uchar> &rgb = frames[size_t(f)];
+        rgb.resize(size_t(width) * height * 3);
+        for(int y = 0; y < height; ++y) {
+            uchar *row = rgb.data() + size_t(y) * width * 3;
+            for(int x = 0; x < width; ++x) {
+                row[x * 3 + 0] = uchar((x + f * 17) & 0xff);
+                row[x * 3 + 1] = uchar((y + f * 31) & 0xff);
+                row[x * 3 + 2] = uchar((x + y) & 0xff);
+            }
+        }
+    }
+    return frames;
+}
+
+static QJsonObject levelToJson(LevelResult &level)
+{
+    QJsonObject json;
+    json["streams"] = level.streams;
+    json["seconds"] = level.seconds;
+    json["offeredFps"] = level.seconds > 0.0 ? level.offered / level.seconds : 0.0;
+    json["throughputFps"] = level.seconds > 0.0 ? level.completed / level.seconds : 0.0;
+    json["offered"] = qint64(level.offered);
+    json["completed"] = qint64(level.completed);
+    json["dropRate"] = level.dropRate();
+    json["drops"] = QJsonObject {
+        {"inFlight", qint64(level.droppedInFlight)},
+        {"rejected", qint64(level.rejected)},
+        {"expired", qint64(level.expired)}
+    };
+    json["failed"] = qint64(level.failed);
+    json["avgBatchSize"] = level.avgBatchSize;
+    json["stages"] = QJsonObject {
+        {"preprocess", level.preprocess.toJson()},
+        {"queue", level.queue.toJson()},
+        {"infer", level.infer.toJson()},
+        {"parse", level.parse.toJson()},
+        {"endToEnd", level.endToEnd.toJson()}
+    };
+    json["poolUtilization"] = level.pools;
+    json["saturated"] = level.saturated;
+    return json;
+}
+
+static QJsonObject configToJson(const BenchConfig &config)
+{
+    QJsonArray batchSizes;
+    for(int size : config.batchSizes)
+        batchSizes.append(size);
+    return QJsonObject {
+        {"width", config.width},
+        {"height", config.height},
+        {"fps", config.fps},
+        {"streamsStart", config.streamsStart},
+        {"streamsStep", config.streamsStep},
+        {"maxStreams", config.maxStreams},
+        {"durationS", config.durationS},
+        {"warmupS", config.warmupS},
+        {"inputSize", config.inputSize},
+        {"batchSizes", batchSizes},
+        {"inferFixedMs", config.latency.fixedMs},
+        {"inferPerItemMs", config.latency.perItemMs},
+        {"inferJitter", config.latency.jitter},
+        {"boxes", config.boxes},
+        {"maxInFlight", config.maxInFlight},
+        {"maxQueue", config.maxQueue},
+        {"batchWindowUs", config.batchWindowUs},
+        {"deadlineFrames", config.deadlineFrames},
+        {"dropThreshold", config.dropThreshold},
+        {"latencyBudgetMs", config.budgetMs()},
+        {"idealThreadCount", QThread::idealThreadCount()}
+    };
+}
+
+static bool parseArguments(const QCoreApplication &app, BenchConfig &config, QString *output)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Multi-stream load generator and saturation benchmark");
+    parser.addHelpOption();
+    const QList<QCommandLineOption> options {
+        {"width", "Frame width.", "px", QString::number(config.width)},
+        {"height", "Frame height.", "px", QString::number(config.height)},
+        {"fps", "Frame rate of every stream.", "fps", QString::number(config.fps)},
+        {"streams", "First stream count of the sweep.", "n", QString::number(config.streamsStart)},
+        {"step", "Streams added per level.", "n", QString::number(config.streamsStep)},
+        {"max-streams", "Last stream count tried.", "n", QString::number(config.maxStreams)},
+        {"duration", "Measured seconds per level.", "s", QString::number(config.durationS)},
+        {"warmup", "Unmeasured seconds before each level.", "s", QString::number(config.warmupS)},
+        {"input-size", "Model input side.", "px", QString::number(config.inputSize)},
+        {"batch-sizes", "Batch sizes of the stand-in backend.", "list", "1,2,4"},
+        {"infer-fixed", "Inference latency per call.", "ms", QString::number(config.latency.fixedMs)},
+        {"infer-per-item", "Inference latency per item at 640.", "ms", QString::number(config.latency.perItemMs)},
+        {"infer-jitter", "Relative deviation of the inference latency.", "f", QString::number(config.latency.jitter)},
+        {"boxes", "Detections in every synthetic output.", "n", QString::number(config.boxes)},
+        {"max-in-flight", "Frames per stream in the pipeline before dropping.", "n", QString::number(config.maxInFlight)},
+        {"max-queue", "Detector queue length.", "n", QString::number(config.maxQueue)},
+        {"batch-window", "Batch fill window.", "us", QString::number(config.batchWindowUs)},
+        {"deadline-frames", "Frame periods a frame may wait in the queue.", "f", QString::number(config.deadlineFrames)},
+        {"drop-threshold", "Drop rate that counts as saturated.", "f", QString::number(config.dropThreshold)},
+        {"latency-budget", "End-to-end p99 that counts as saturated, 0 for 3 frame periods.", "ms", "0"},
+        {"label", "Build or run label stored in the results.", "text"},
+        {"output", "Write the JSON results here instead of stdout.", "file"}
+    };
+    parser.addOptions(options);
+    parser.process(app);
+
+    auto number = [&parser](const QString &name) { return parser.value(name).toDouble(); };
+    config.width = int(number("width"));
+    config.height = int(number("height"));
+    config.fps = number("fps");
+    config.streamsStart = int(number("streams"));
+    config.streamsStep = int(number("step"));
+    config.maxStreams = int(number("max-streams"));
+    config.durationS = number("duration");
+    config.warmupS = number("warmup");
+    config.inputSize = int(number("input-size"));
+    config.batchSizes.clear();
+    for(const QString &size : parser.value("batch-sizes").split(',', Qt::SkipEmptyParts))
+        config.batchSizes.append(size.trimmed().toInt());
+    config.latency.fixedMs = number("infer-fixed");
+    config.latency.perItemMs = number("infer-per-item");
+    config.latency.jitter = number("infer-jitter");
+    config.boxes = int(number("boxes"));
+    config.maxInFlight = int(number("max-in-flight"));
+    config.maxQueue = int(number("max-queue"));
+    config.batchWindowUs = int(number("batch-window"));
+    config.deadlineFrames = number("deadline-frames");
+    config.dropThreshold = number("drop-threshold");
+    config.latencyBudgetMs = number("latency-budget");
+    config.label = parser.value("label");
+
+    if(config.width <= 0 || config.height <= 0 || config.fps <= 0.0 ||
+       config.streamsStart <= 0 || config.streamsStep <= 0 || config.maxStreams < config.streamsStart ||
+       config.durationS <= 0.0 || config.inputSize <= 0 || config.batchSizes.isEmpty() ||
+       config.maxInFlight <= 0) {
+        qWarning() << "Invalid benchmark configuration";
+        return false;
+    }
+    *output = parser.value("output");
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("benchLoad");
+
+    BenchConfig config;
+    QString output;
+    if(!parseArguments(app, config, &output))
+        return 1;
+
+    const std::vector<std::vector<uchar>> frames = makeFrames(config.width, config.height, 4);
+    QJsonArray levels;
+    int sustained = 0;
+    int saturatedAt = 0;
+    for(int streams = config.streamsStart; streams <= config.maxStreams; streams += config.streamsStep) {
+        LoadLevel level(config, streams, frames);
+        LevelResult result = level.run();
+        qInfo().noquote() << QString("%1 streams: %2 fps of %3, drops %4%, e2e p99 %5 ms%6")
+                                 .arg(streams)
+                                 .arg(result.seconds > 0.0 ? result.completed / result.seconds : 0.0, 0, 'f', 1)
+                                 .arg(result.seconds > 0.0 ? result.offered / result.seconds : 0.0, 0, 'f', 1)
+                                 .arg(100.0 * result.dropRate(), 0, 'f', 2)
+                                 .arg(result.endToEnd.percentile(0.99), 0, 'f', 2)
+                                 .arg(result.saturated ? ", saturated" : "");
+        levels.append(levelToJson(result));
+        if(result.saturated) {
+            saturatedAt = streams;
+            break;
+        }
+        sustained = streams;
+    }
+
+    QJsonObject root {
+        {"benchmark", "objectdetector-load"},
+        {"label", config.label},
+        {"config", configToJson(config)},
+        {"levels", levels},
+        {"maxSustainedStreams", sustained},
+        {"saturatedAt", saturatedAt > 0 ? QJsonValue(saturatedAt) : QJsonValue()}
+    };
+    const QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+
+    if(output.isEmpty()) {
+        QFile out;
+        if(!out.open(stdout, QIODevice::WriteOnly))
+            return 1;
+        out.write(json);
+        return 0;
+    }
+    QFile out(output);
+    if(!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write" << output;
+        return 1;
+    }
+    out.write(json);
+    return 0;
+}
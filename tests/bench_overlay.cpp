@@ -0,0 +1,177 @@
+#include <QTest>
+#include <QElapsedTimer>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QQuickWindow>
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <vector>
+
+#include "../model/yoloparser.h"
+#include "../view/detectionoverlay.h"
+
+// The per-box Repeater overlay that view/Main.qml used before DetectionOverlay
+static const char *REPEATER_OVERLAY = R"(
+import QtQuick
+Item {
+    property var detections: []
+    Repeater {
+        model: parent.detections
+        Rectangle {
+            x: modelData.rect.x * parent.width / modelData.origW
+            y: modelData.rect.y * parent.height / modelData.origH
+            width: modelData.rect.width * parent.width / modelData.origW
+            height: modelData.rect.height * parent.height / modelData.origH
+            color: "transparent"
+            border.color: "red"
+            border.width: 3
+            Text {
+                text: modelData.label
+                color: "lime"
+                font.pixelSize: 14
+                anchors.bottom: parent.bottom
+                anchors.right: parent.right
+                anchors.margins: 4
+            }
+        }
+    }
+}
+)";
+
+static const char *SCENEGRAPH_OVERLAY = R"(
+import QtQuick
+import ObjectDetectorBench
+Item {
+    property var detections: []
+    DetectionOverlay {
+        anchors.fill: parent
+        detections: parent.detections
+        boxColor: "red"
+        labelColor: "lime"
+        lineWidth: 3
+    }
+}
+)";
+
+static QVariantList makeDetections(int count, QRandomGenerator &rng)
+{
+    QVariantList list;
+    list.reserve(count);
+    for(int i = 0; i < count; ++i) {
+        QVariantMap map;
+        const int w = 40 + rng.bounded(160);
+        const int h = 40 + rng.bounded(160);
+        map["rect"] = QRect(rng.bounded(1920 - w), rng.bounded(1080 - h), w, h);
+        map["label"] = YoloParser::YOLO_CLASSES.at(rng.bounded(int(YoloParser::YOLO_CLASSES.size())));
+        map["score"] = 0.5 + rng.generateDouble() / 2;
+        map["origW"] = 1920;
+        map["origH"] = 1080;
+        list.append(map);
+    }
+    return list;
+}
+
+// Frame-time comparison between the QML Repeater overlay and the scene graph
+// overlay. It needs a real window, so it is built but not registered with
+// ctest; run benchOverlay manually on a machine with a display.
+class BenchOverlay : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void frameTime_data();
+    void frameTime();
+};
+
+void BenchOverlay::initTestCase()
+{
+    qmlRegisterType<DetectionOverlay>("ObjectDetectorBench", 1, 0, "DetectionOverlay");
+}
+
+void BenchOverlay::frameTime_data()
+{
+    QTest::addColumn<bool>("sceneGraph");
+    QTest::addColumn<int>("boxes");
+
+    for(int boxes : {10, 50, 200}) {
+        QTest::addRow("repeater %d", boxes) << false << boxes;
+        QTest::addRow("scenegraph %d", boxes) << true << boxes;
+    }
+}
+
+void BenchOverlay::frameTime()
+{
+    QFETCH(bool, sceneGraph);
+    QFETCH(int, boxes);
+    constexpr int FRAMES = 300;
+
+    QQuickWindow window;
+    window.resize(1280, 720);
+
+    QQmlEngine engine;
+    QQmlComponent component(&engine);
+    component.setData(sceneGraph ? SCENEGRAPH_OVERLAY : REPEATER_OVERLAY, QUrl());
+    QScopedPointer<QQuickItem> root(qobject_cast<QQuickItem*>(component.create()));
+    QVERIFY2(root, qPrintable(component.errorString()));
+    root->setParentItem(window.contentItem());
+    root->setSize(window.size());
+
+    window.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&window));
+
+    QRandomGenerator rng(42);
+    std::vector<QVariantList> frames;
+    for(int i = 0; i < 8; ++i)
+        frames.push_back(makeDetections(boxes, rng));
+
+    std::vector<double> frameMs;
+    std::vector<double> updateMs;
+    frameMs.reserve(FRAMES);
+    updateMs.reserve(FRAMES);
+    QElapsedTimer frameTimer;
+    int frame = 0;
+
+    // Push a new detection list after every presented frame, like the camera
+    // pipeline does at its own rate, and time both the GUI-thread update and
+    // the interval between presented frames.
+    auto next = [&]() {
+        if(frame > 0)
+            frameMs.push_back(frameTimer.nsecsElapsed() / 1e6);
+        frameTimer.start();
+        if(frame++ >= FRAMES) return;
+
+        QElapsedTimer updateTimer;
+        updateTimer.start();
+        root->setProperty("detections", frames[frame % frames.size()]);
+        window.update();
+        updateMs.push_back(updateTimer.nsecsElapsed() / 1e6);
+    };
+    connect(&window, &QQuickWindow::frameSwapped, this, next, Qt::QueuedConnection);
+    next();
+
+    QTRY_VERIFY_WITH_TIMEOUT(frame > FRAMES, 60000);
+
+    std::sort(frameMs.begin(), frameMs.end());
+    double total = 0.0;
+    for(double ms : frameMs) total += ms;
+    const double mean = total / frameMs.size();
+    const double p99 = frameMs[size_t(frameMs.size() * 0.99)];
+
+    double updateTotal = 0.0;
+    for(double ms : updateMs) updateTotal += ms;
+
+    qInfo().noquote() << QString("%1 %2 boxes: frame mean %3 ms, p99 %4 ms, GUI update mean %5 ms")
+                             .arg(sceneGraph ? "scenegraph" : "repeater")
+                             .arg(boxes)
+                             .arg(mean, 0, 'f', 2)
+                             .arg(p99, 0, 'f', 2)
+                             .arg(updateTotal / updateMs.size(), 0, 'f', 3);
+    QTest::setBenchmarkResult(mean, QTest::WalltimeMilliseconds);
+}
+
+QTEST_MAIN(BenchOverlay)
+
+#include "bench_overlay.moc"
@@ -0,0 +1,253 @@
+#include <QTest>
+#include <QThread>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "../model/asyncdetector.h"
+
+// Backend that returns one box per batch item, placed from the item's first
+// input value, so each result can be traced back to its request.
+class FakeBackend : public InferenceBackend
+{
+public:
+    QList<int> batchSizes {1, 2, 4};
+    std::atomic_bool hold{false};
+    std::atomic_bool inferring{false};
+    std::mutex mutex;
+    QList<int> calls;
+
+    bool load(QString *) override { return true; }
+    bool compile(QString *) override { return true; }
+
+    bool infer(const float *input, int batch, InferenceOutput &output, QString *) override {
+        inferring = true;
+        while(hold)
+            QThread::msleep(1);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            calls.append(batch);
+        }
+
+        const int C = 6;
+        const int N = 4;
+        const qsizetype plane = 3 * qsizetype(inputSize()) * inputSize();
+        output.shape = {batch, C, N};
+        output.data = QByteArray(qsizetype(batch) * C * N * sizeof(float), 0);
+        float *out = reinterpret_cast<float*>(output.data.data());
+        for(int b = 0; b < batch; ++b) {
+            float *item = out + b * C * N;
+            item[0 * N] = 8.f + input[b * plane] * 10.f;  // cx
+            item[1 * N] = 8.f;                             // cy
+            item[2 * N] = 4.f;                             // w
+            item[3 * N] = 4.f;                             // h
+            item[4 * N] = 0.9f;                            // class 0
+        }
+        inferring = false;
+        return true;
+    }
+
+    QList<int> supportedBatchSizes() const override { return batchSizes; }
+    int inputSize() const override { return 32; }
+};
+
+static DetectionRequest makeRequest(float value)
+{
+    DetectionRequest request;
+    request.input.assign(3 * 32 * 32, value);
+    request.letterbox = YoloParser::letterboxFor(32, 32, 32);
+    return request;
+}
+
+class TestAsyncDetector : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void concurrentRequestsShareABatch();
+    void partialBatchIsPadded();
+    void expiredRequestIsNotRun();
+    void cancelledRequestIsNotParsed();
+    void fullQueueRejects();
+    void malformedInputFails();
+    void queuedRequestsAreCancelledOnShutdown();
+    void fromRgbLetterboxesImage();
+};
+
+void TestAsyncDetector::concurrentRequestsShareABatch()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    AsyncDetector::Options options;
+    options.batchWindow = std::chrono::milliseconds(500);
+    AsyncDetector detector(backend, options);
+
+    std::vector<DetectionTicket> tickets(4);
+    std::vector<std::thread> clients;
+    for(int i = 0; i < 4; ++i)
+        clients.emplace_back([&, i]() { tickets[i] = detector.submit(makeRequest(i * 0.1f)); });
+    for(auto &client : clients)
+        client.join();
+
+    for(int i = 0; i < 4; ++i) {
+        const DetectionResult result = tickets[i].result.get();
+        QCOMPARE(result.status, DetectionResult::Status::Ok);
+        QCOMPARE(result.batchSize, 4);
+        QCOMPARE(result.detections.size(), 1);
+        // cx - w / 2 with an identity letterbox
+        QCOMPARE(result.detections[0].rect.x(), 6 + i);
+    }
+    QCOMPARE(backend->calls, QList<int>({4}));
+
+    const AsyncDetector::Stats stats = detector.stats();
+    QCOMPARE(stats.submitted, quint64(4));
+    QCOMPARE(stats.completed, quint64(4));
+    QCOMPARE(stats.batches, quint64(1));
+    QCOMPARE(stats.batchedRequests, quint64(4));
+}
+
+void TestAsyncDetector::partialBatchIsPadded()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->batchSizes = {4, 2};
+    AsyncDetector::Options options;
+    options.batchWindow = std::chrono::milliseconds(100);
+    AsyncDetector detector(backend, options);
+
+    std::vector<DetectionTicket> tickets;
+    for(int i = 0; i < 3; ++i)
+        tickets.push_back(detector.submit(makeRequest(i * 0.1f)));
+    for(auto &ticket : tickets) {
+        const DetectionResult result = ticket.result.get();
+        QCOMPARE(result.status, DetectionResult::Status::Ok);
+        QCOMPARE(result.batchSize, 3);
+    }
+    QCOMPARE(backend->calls, QList<int>({4}));
+}
+
+void TestAsyncDetector::expiredRequestIsNotRun()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    AsyncDetector detector(backend);
+
+    DetectionRequest request = makeRequest(0.f);
+    request.deadline = DetectionClock::now() - std::chrono::milliseconds(1);
+    const DetectionResult result = detector.submit(request).result.get();
+
+    QCOMPARE(result.status, DetectionResult::Status::DeadlineExceeded);
+    QVERIFY(backend->calls.isEmpty());
+    QCOMPARE(detector.stats().expired, quint64(1));
+}
+
+void TestAsyncDetector::cancelledRequestIsNotParsed()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->batchSizes = {1};
+    backend->hold = true;
+    AsyncDetector::Options options;
+    options.batchWindow = std::chrono::microseconds(0);
+    AsyncDetector detector(backend, options);
+
+    DetectionTicket first = detector.submit(makeRequest(0.f));
+    QTRY_VERIFY(backend->inferring.load());
+    DetectionTicket second = detector.submit(makeRequest(0.1f));
+    second.cancel();
+    QVERIFY(second.isCancelled());
+    backend->hold = false;
+
+    QCOMPARE(first.result.get().status, DetectionResult::Status::Ok);
+    QCOMPARE(second.result.get().status, DetectionResult::Status::Cancelled);
+    QCOMPARE(backend->calls, QList<int>({1}));
+}
+
+void TestAsyncDetector::fullQueueRejects()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->batchSizes = {1};
+    backend->hold = true;
+    AsyncDetector::Options options;
+    options.maxQueue = 1;
+    options.batchWindow = std::chrono::microseconds(0);
+    AsyncDetector detector(backend, options);
+
+    DetectionTicket running = detector.submit(makeRequest(0.f));
+    QTRY_VERIFY(backend->inferring.load());
+    DetectionTicket queued = detector.submit(makeRequest(0.1f));
+    DetectionTicket rejected = detector.submit(makeRequest(0.2f));
+
+    QVERIFY(rejected.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready);
+    const DetectionResult result = rejected.result.get();
+    QCOMPARE(result.status, DetectionResult::Status::Rejected);
+    QCOMPARE(result.error, QString("Queue full"));
+
+    backend->hold = false;
+    QCOMPARE(running.result.get().status, DetectionResult::Status::Ok);
+    QCOMPARE(queued.result.get().status, DetectionResult::Status::Ok);
+    QCOMPARE(detector.stats().rejected, quint64(1));
+}
+
+void TestAsyncDetector::malformedInputFails()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    AsyncDetector detector(backend);
+
+    DetectionRequest request;
+    request.input.assign(10, 0.f);
+    const DetectionResult result = detector.submit(request).result.get();
+    QCOMPARE(result.status, DetectionResult::Status::Failed);
+    QVERIFY(result.error.contains("expected 3072"));
+    QVERIFY(backend->calls.isEmpty());
+}
+
+void TestAsyncDetector::queuedRequestsAreCancelledOnShutdown()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->batchSizes = {1};
+    backend->hold = true;
+    AsyncDetector::Options options;
+    options.batchWindow = std::chrono::microseconds(0);
+    auto detector = std::make_unique<AsyncDetector>(backend, options);
+
+    DetectionTicket running = detector->submit(makeRequest(0.f));
+    QTRY_VERIFY(backend->inferring.load());
+    DetectionTicket queued = detector->submit(makeRequest(0.1f));
+
+    // Released only once the destructor is already waiting
+    std::thread release([&]() {
+        QThread::msleep(50);
+        backend->hold = false;
+    });
+    detector.reset();
+    release.join();
+
+    QCOMPARE(running.result.get().status, DetectionResult::Status::Ok);
+    QCOMPARE(queued.result.get().status, DetectionResult::Status::Cancelled);
+}
+
+void TestAsyncDetector::fromRgbLetterboxesImage()
+{
+    // 4 x 2 red image into an 8 x 8 input: scale 2, 2 rows of padding
+    const int width = 4;
+    const int height = 2;
+    std::vector<uchar> rgb(width * height * 3, 0);
+    for(int i = 0; i < width * height; ++i)
+        rgb[i * 3] = 255;
+
+    const DetectionRequest request = DetectionRequest::fromRgb(rgb.data(), width, height, width * 3, 8);
+    QCOMPARE(request.letterbox.scale, 2.f);
+    QCOMPARE(request.letterbox.padX, 0);
+    QCOMPARE(request.letterbox.padY, 2);
+    QCOMPARE(request.letterbox.origW, 4);
+    QCOMPARE(request.input.size(), size_t(3 * 8 * 8));
+
+    const float grey = 114.f / 255.f;
+    const int plane = 8 * 8;
+    QCOMPARE(request.input[0], grey);                   // R, padding row
+    QCOMPARE(request.input[2 * 8 + 3], 1.f);            // R, image row
+    QCOMPARE(request.input[plane + 2 * 8 + 3], 0.f);    // G, image row
+    QCOMPARE(request.input[2 * plane + 7 * 8], grey);   // B, bottom padding
+}
+
+QTEST_APPLESS_MAIN(TestAsyncDetector)
+
+#include "tst_asyncdetector.moc"
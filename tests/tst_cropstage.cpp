@@ -0,0 +1,286 @@
+#include <QTest>
+
+#include <atomic>
+#include <vector>
+
+#include "../model/cropstage.h"
+
+static constexpr float PAD = 114.f / 255.f;
+
+// RGB image whose left half is red and right half is blue
+static std::vector<uchar> splitImage(int width, int height)
+{
+    std::vector<uchar> rgb(size_t(width) * height * 3, 0);
+    for(int y = 0; y < height; ++y)
+    for(int x = 0; x < width; ++x) {
+        uchar *p = rgb.data() + (size_t(y) * width + x) * 3;
+        p[x < width / 2 ? 0 : 2] = 255;
+    }
+    return rgb;
+}
+
+static CropSource rgbSource(const std::vector<uchar> &rgb, int width, int height,
+                            std::shared_ptr<const void> owner = nullptr)
+{
+    CropSource source;
+    source.format = CropSource::Rgb888;
+    source.width = width;
+    source.height = height;
+    source.planes[0] = rgb.data();
+    source.bytesPerLine[0] = width * 3;
+    source.owner = std::move(owner);
+    return source;
+}
+
+static Detection detection(int classId, const QRect &rect, float score = 0.9f)
+{
+    Detection det;
+    det.classId = classId;
+    det.rect = rect;
+    det.score = score;
+    return det;
+}
+
+class RecordingBackend : public SecondStageBackend
+{
+public:
+    int size = 16;
+    QList<int> wanted;
+    std::atomic<int> calls{0};
+    std::atomic<int> worker{-2};
+    QList<CropInfo> crops;
+
+    int cropSize() const override { return size; }
+    QList<int> classes() const override { return wanted; }
+    void process(const CropBatch &batch) override {
+        crops = batch.crops;
+        worker = Executor::instance().pool(Executor::POSTPROCESS)->currentWorker();
+        ++calls;
+    }
+};
+
+class TestCropStage : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void tensorPoolRecyclesBuffers();
+    void cropsAreLetterboxedIntoOneTensor();
+    void pixelFormatsAgree();
+    void classesMarginAndLimitsSelectCrops();
+    void submitRunsOnPostprocessPoolAndReleasesSources();
+    void parserHandsParsedBatchToCropStage();
+};
+
+void TestCropStage::tensorPoolRecyclesBuffers()
+{
+    TensorPool pool(2);
+    const float *first = nullptr;
+    {
+        TensorPool::Buffer a = pool.acquire(100);
+        QCOMPARE(a->size(), size_t(100));
+        first = a->data();
+    }
+    QCOMPARE(pool.freeCount(), 1);
+
+    TensorPool::Buffer b = pool.acquire(50);
+    QCOMPARE(b->size(), size_t(50));
+    QCOMPARE(static_cast<const float*>(b->data()), first);
+    TensorPool::Buffer c = pool.acquire(200);
+    QCOMPARE(pool.allocations(), quint64(2));
+    QCOMPARE(pool.reuses(), quint64(1));
+
+    // Buffers outliving the pool are simply freed
+    auto *orphanPool = new TensorPool(1);
+    TensorPool::Buffer orphan = orphanPool->acquire(10);
+    delete orphanPool;
+    orphan.reset();
+}
+
+void TestCropStage::cropsAreLetterboxedIntoOneTensor()
+{
+    const std::vector<uchar> rgb = splitImage(100, 50);
+    CropStage stage;
+    QList<QList<Detection>> detections;
+    // 40 x 20 red box, then 10 x 40 blue box
+    detections.append({detection(0, QRect(5, 10, 40, 20)),
+                       detection(1, QRect(80, 5, 10, 40))});
+
+    const CropBatch batch = stage.extract({rgbSource(rgb, 100, 50)}, detections, 16);
+    QCOMPARE(batch.count(), 2);
+    QCOMPARE(batch.cropSize, 16);
+    QCOMPARE(batch.tensor->size(), size_t(2 * 3 * 16 * 16));
+    QCOMPARE(batch.crop(1), batch.data() + 3 * 16 * 16);
+
+    // Same math as the detector input
+    const CropInfo &wide = batch.crops.at(0);
+    QCOMPARE(wide.rect, QRect(5, 10, 40, 20));
+    QCOMPARE(wide.letterbox.scale, 0.4f);
+    QCOMPARE(wide.letterbox.padX, 0);
+    QCOMPARE(wide.letterbox.padY, 4);
+    QCOMPARE(wide.letterbox.inputSize, 16);
+
+    const qsizetype plane = 16 * 16;
+    const float *red = batch.crop(0);
+    QCOMPARE(red[0], PAD);                      // top padding row
+    QCOMPARE(red[5 * 16 + 8], 1.f);             // R
+    QCOMPARE(red[plane + 5 * 16 + 8], 0.f);     // G
+    QCOMPARE(red[2 * plane + 5 * 16 + 8], 0.f); // B
+    QCOMPARE(red[15 * 16], PAD);                // bottom padding row
+
+    const CropInfo &tall = batch.crops.at(1);
+    QCOMPARE(tall.letterbox.padX, 6);
+    QCOMPARE(tall.letterbox.padY, 0);
+    const float *blue = batch.crop(1);
+    QCOMPARE(blue[8 * 16 + 0], PAD);            // left padding column
+    QCOMPARE(blue[8 * 16 + 8], 0.f);
+    QCOMPARE(blue[2 * plane + 8 * 16 + 8], 1.f);
+}
+
+void TestCropStage::pixelFormatsAgree()
+{
+    const int w = 8;
+    const int h = 8;
+    // Mid grey in every format; NV12 video range 126 maps to ~128
+    std::vector<uchar> rgb(size_t(w) * h * 3, 128);
+    std::vector<uchar> bgra(size_t(w) * h * 4, 128);
+    std::vector<uchar> luma(size_t(w) * h, 126);
+    std::vector<uchar> chroma(size_t(w) * h / 2, 128);
+
+    CropSource bgraSource;
+    bgraSource.format = CropSource::Bgra8888;
+    bgraSource.width = w;
+    bgraSource.height = h;
+    bgraSource.planes[0] = bgra.data();
+    bgraSource.bytesPerLine[0] = w * 4;
+
+    CropSource nv12Source;
+    nv12Source.format = CropSource::Nv12;
+    nv12Source.width = w;
+    nv12Source.height = h;
+    nv12Source.planes[0] = luma.data();
+    nv12Source.planes[1] = chroma.data();
+    nv12Source.bytesPerLine[0] = w;
+    nv12Source.bytesPerLine[1] = w;
+
+    CropStage stage;
+    QList<QList<Detection>> detections;
+    for(int i = 0; i < 3; ++i)
+        detections.append({detection(0, QRect(0, 0, w, h))});
+    const CropBatch batch = stage.extract({rgbSource(rgb, w, h), bgraSource, nv12Source},
+                                          detections, 8);
+    QCOMPARE(batch.count(), 3);
+    for(int i = 0; i < 3; ++i) {
+        for(int c = 0; c < 3; ++c) {
+            const float value = batch.crop(i)[c * 64 + 3 * 8 + 3];
+            QVERIFY2(qAbs(value - 128.f / 255.f) < 0.01f,
+                     qPrintable(QString("crop %1 channel %2: %3").arg(i).arg(c).arg(value)));
+        }
+    }
+}
+
+void TestCropStage::classesMarginAndLimitsSelectCrops()
+{
+    const std::vector<uchar> rgb = splitImage(100, 100);
+    CropStage::Options options;
+    options.maxCrops = 2;
+    options.margin = 0.5f;
+    options.minSide = 6;
+    CropStage stage(options);
+
+    QList<QList<Detection>> detections;
+    detections.append({detection(0, QRect(0, 0, 10, 10), 0.5f),    // margin clipped at the edge
+                       detection(2, QRect(40, 40, 10, 10), 0.9f),   // class not wanted
+                       detection(0, QRect(50, 50, 2, 2), 0.9f)});   // too small even with margin
+    detections.append({detection(0, QRect(20, 20, 10, 10), 0.8f),
+                       detection(0, QRect(60, 60, 10, 10), 0.3f)}); // lowest score, over the cap
+
+    const CropBatch batch = stage.extract({rgbSource(rgb, 100, 100), rgbSource(rgb, 100, 100)},
+                                          detections, 8, {0});
+    QCOMPARE(batch.count(), 2);
+    QCOMPARE(batch.crops.at(0).frame, 0);
+    QCOMPARE(batch.crops.at(0).detection, 0);
+    QCOMPARE(batch.crops.at(0).rect, QRect(0, 0, 15, 15));
+    QCOMPARE(batch.crops.at(1).frame, 1);
+    QCOMPARE(batch.crops.at(1).detection, 0);
+    QCOMPARE(batch.crops.at(1).rect, QRect(15, 15, 20, 20));
+    QCOMPARE(stage.stats().skipped, quint64(2));
+    QCOMPARE(stage.stats().crops, quint64(2));
+
+    // A frame without pixels contributes nothing
+    QCOMPARE(stage.extract({CropSource()}, detections, 8).count(), 0);
+}
+
+void TestCropStage::submitRunsOnPostprocessPoolAndReleasesSources()
+{
+    auto backend = std::make_shared<RecordingBackend>();
+    CropStage stage;
+    QVERIFY(!stage.hasBackend());
+    std::weak_ptr<const void> watch;
+    {
+        auto pixels = std::make_shared<std::vector<uchar>>(splitImage(64, 64));
+        const std::vector<uchar> &rgb = *pixels;
+        CropSource source = rgbSource(rgb, 64, 64, pixels);
+        watch = pixels;
+
+        QList<QList<Detection>> detections;
+        detections.append({detection(0, QRect(8, 8, 16, 16))});
+        // No backend yet: nothing is queued and nothing is kept
+        stage.submit({source}, detections);
+        stage.wait();
+        QCOMPARE(backend->calls.load(), 0);
+
+        stage.setBackend(backend);
+        QVERIFY(stage.hasBackend());
+        stage.submit({source}, detections);
+    }
+    stage.wait();
+    QCOMPARE(backend->calls.load(), 1);
+    QVERIFY(backend->worker.load() >= 0);
+    QCOMPARE(backend->crops.size(), 1);
+    QVERIFY(watch.expired());
+
+    const CropStageStats stats = stage.stats();
+    QCOMPARE(stats.batches, quint64(1));
+    QCOMPARE(stats.crops, quint64(1));
+}
+
+void TestCropStage::parserHandsParsedBatchToCropStage()
+{
+    auto backend = std::make_shared<RecordingBackend>();
+    auto stage = std::make_shared<CropStage>();
+    stage->setBackend(backend);
+    YoloParser parser;
+    parser.setCropStage(stage);
+
+    // One item, one box at (20, 20) 16 x 16 in a 64 x 64 input, class 0
+    const int C = 6;
+    const int N = 4;
+    QByteArray blob(C * N * int(sizeof(float)), 0);
+    float *out = reinterpret_cast<float*>(blob.data());
+    out[0 * N] = 28.f;
+    out[1 * N] = 28.f;
+    out[2 * N] = 16.f;
+    out[3 * N] = 16.f;
+    out[4 * N] = 0.9f;
+
+    // Source is twice the input size
+    auto pixels = std::make_shared<std::vector<uchar>>(splitImage(128, 128));
+    const QVector<YoloParser::LetterboxInfo> letterbox {YoloParser::letterboxFor(128, 128, 64)};
+    parser.parseBatch(blob, {1, C, N}, letterbox, {rgbSource(*pixels, 128, 128, pixels)});
+
+    QTRY_COMPARE(backend->calls.load(), 1);
+    QCOMPARE(backend->crops.size(), 1);
+    QCOMPARE(backend->crops.at(0).rect, QRect(40, 40, 32, 32));
+    QCOMPARE(backend->crops.at(0).classId, 0);
+
+    // Without sources the crop stage is not involved
+    parser.parseBatch(blob, {1, C, N}, letterbox);
+    QTest::qWait(50);
+    stage->wait();
+    QCOMPARE(backend->calls.load(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestCropStage)
+
+#include "tst_cropstage.moc"
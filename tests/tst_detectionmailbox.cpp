@@ -0,0 +1,116 @@
+#include <QTest>
+
+#include <atomic>
+#include <thread>
+
+#include "../model/detectionmailbox.h"
+
+class TestDetectionMailbox : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emptyMailboxHasNoUpdate();
+    void readerSeesPublishedValue();
+    void unreadValuesAreCoalesced();
+    void concurrentPublishIsNeverTorn();
+};
+
+void TestDetectionMailbox::emptyMailboxHasNoUpdate()
+{
+    DetectionMailbox mailbox;
+    QVERIFY(!mailbox.update());
+    QCOMPARE(mailbox.readBuffer().sequence, quint64(0));
+}
+
+void TestDetectionMailbox::readerSeesPublishedValue()
+{
+    DetectionMailbox mailbox;
+
+    DetectionFrame &frame = mailbox.writeBuffer();
+    frame.sequence = 1;
+    Detection det;
+    det.classId = 2;
+    det.label = "car";
+    frame.detections = {det};
+    mailbox.publish();
+
+    QVERIFY(mailbox.update());
+    QCOMPARE(mailbox.readBuffer().sequence, quint64(1));
+    QCOMPARE(mailbox.readBuffer().detections.size(), 1);
+    QCOMPARE(mailbox.readBuffer().detections[0].label, QString("car"));
+
+    // Nothing new, the last value stays readable
+    QVERIFY(!mailbox.update());
+    QCOMPARE(mailbox.readBuffer().sequence, quint64(1));
+}
+
+void TestDetectionMailbox::unreadValuesAreCoalesced()
+{
+    DetectionMailbox mailbox;
+    for(quint64 seq = 1; seq <= 5; ++seq) {
+        mailbox.writeBuffer().sequence = seq;
+        mailbox.publish();
+    }
+
+    QVERIFY(mailbox.update());
+    QCOMPARE(mailbox.readBuffer().sequence, quint64(5));
+    QCOMPARE(mailbox.coalescedCount(), quint64(4));
+    QVERIFY(!mailbox.update());
+}
+
+void TestDetectionMailbox::concurrentPublishIsNeverTorn()
+{
+    // Each value stores its sequence in every field; a reader observing
+    // mixed fields would mean a slot was shared between both sides.
+    struct Payload {
+        quint64 a = 0;
+        quint64 b = 0;
+        QList<quint64> list;
+    };
+    TripleBuffer<Payload> mailbox;
+    constexpr quint64 COUNT = 200000;
+    std::atomic_bool done{false};
+
+    std::thread writer([&]() {
+        for(quint64 seq = 1; seq <= COUNT; ++seq) {
+            Payload &p = mailbox.writeBuffer();
+            p.a = seq;
+            p.list = {seq, seq};
+            p.b = seq;
+            mailbox.publish();
+        }
+        done = true;
+    });
+
+    quint64 last = 0;
+    quint64 reads = 0;
+    bool torn = false;
+    bool backwards = false;
+    for(;;) {
+        const bool fresh = mailbox.update();
+        if(!fresh) {
+            if(done) break;
+            continue;
+        }
+        const Payload &p = mailbox.readBuffer();
+        if(p.a != p.b || p.list.size() != 2 || p.list[0] != p.a)
+            torn = true;
+        if(p.a < last)
+            backwards = true;
+        last = p.a;
+        ++reads;
+    }
+    writer.join();
+    mailbox.update();
+    last = mailbox.readBuffer().a;
+
+    QVERIFY(!torn);
+    QVERIFY(!backwards);
+    QVERIFY(reads > 0);
+    QCOMPARE(last, COUNT);
+}
+
+QTEST_APPLESS_MAIN(TestDetectionMailbox)
+
+#include "tst_detectionmailbox.moc"
@@ -0,0 +1,177 @@
+#include <QTest>
+
+#include <atomic>
+
+#include "../model/executor.h"
+
+#ifdef Q_OS_LINUX
+#include <sched.h>
+#endif
+
+class TestExecutor : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parsesCpuLists();
+    void runsEverySubmittedTask();
+    void idleWorkersStealQueuedTasks();
+    void taskGroupWaitsForItsTasks();
+    void statsReportUtilization();
+    void pinsWorkersToConfiguredCpus();
+    void executorProvidesNamedPools();
+};
+
+static PoolConfig makeConfig(const QString &name, int threads)
+{
+    PoolConfig config;
+    config.name = name;
+    config.threads = threads;
+    return config;
+}
+
+void TestExecutor::parsesCpuLists()
+{
+    QCOMPARE(WorkerPool::parseCpuList("0-3,8,10-11\n"), QList<int>({0, 1, 2, 3, 8, 10, 11}));
+    QCOMPARE(WorkerPool::parseCpuList("5"), QList<int>({5}));
+    QVERIFY(WorkerPool::parseCpuList("").isEmpty());
+
+    QTest::ignoreMessage(QtWarningMsg, "Invalid cpulist entry: \"4-2\"");
+    QVERIFY(WorkerPool::parseCpuList("4-2").isEmpty());
+}
+
+void TestExecutor::runsEverySubmittedTask()
+{
+    WorkerPool pool(makeConfig("test", 3));
+    QCOMPARE(pool.threadCount(), 3);
+    QCOMPARE(pool.currentWorker(), -1);
+
+    std::atomic<int> count{0};
+    std::atomic<bool> onWorker{true};
+    for(int i = 0; i < 1000; ++i) {
+        pool.submit([&]() {
+            if(pool.currentWorker() < 0)
+                onWorker = false;
+            count.fetch_add(1);
+        });
+    }
+    pool.waitForIdle();
+
+    QCOMPARE(count.load(), 1000);
+    QVERIFY(onWorker.load());
+    const PoolStats stats = pool.stats();
+    QCOMPARE(stats.submitted, quint64(1000));
+    QCOMPARE(stats.completed, quint64(1000));
+    QCOMPARE(stats.queued, 0);
+}
+
+void TestExecutor::idleWorkersStealQueuedTasks()
+{
+    WorkerPool pool(makeConfig("steal", 2));
+
+    // The parent queues its children on its own deque and then stays busy
+    // until one of them ran elsewhere, which only stealing allows.
+    std::atomic<bool> childRanElsewhere{false};
+    pool.submit([&]() {
+        const int parent = pool.currentWorker();
+        for(int i = 0; i < 8; ++i) {
+            pool.submit([&, parent]() {
+                if(pool.currentWorker() != parent)
+                    childRanElsewhere = true;
+            });
+        }
+        for(int i = 0; i < 500 && !childRanElsewhere; ++i)
+            QThread::msleep(2);
+    });
+    pool.waitForIdle();
+
+    QVERIFY(childRanElsewhere.load());
+    QVERIFY(pool.stats().stolen > 0);
+}
+
+void TestExecutor::taskGroupWaitsForItsTasks()
+{
+    WorkerPool pool(makeConfig("group", 2));
+    std::atomic<int> count{0};
+    {
+        TaskGroup group(&pool);
+        for(int i = 0; i < 16; ++i) {
+            group.run([&]() {
+                QThread::msleep(1);
+                count.fetch_add(1);
+            });
+        }
+        group.wait();
+        QCOMPARE(count.load(), 16);
+        QCOMPARE(group.pending(), 0);
+    }
+
+    // Without a pool the task runs on the caller
+    TaskGroup inlineGroup;
+    bool ran = false;
+    inlineGroup.run([&]() { ran = true; });
+    QVERIFY(ran);
+}
+
+void TestExecutor::statsReportUtilization()
+{
+    WorkerPool pool(makeConfig("stats", 2));
+    for(int i = 0; i < 4; ++i)
+        pool.submit([]() { QThread::msleep(10); });
+    pool.waitForIdle();
+
+    const PoolStats stats = pool.stats();
+    QCOMPARE(stats.name, QString("stats"));
+    QCOMPARE(stats.threads, 2);
+    QVERIFY(stats.busyMs >= 35.0);
+    QVERIFY(stats.utilization() > 0.0);
+    QVERIFY(stats.utilization() <= 1.0);
+}
+
+void TestExecutor::pinsWorkersToConfiguredCpus()
+{
+#ifdef Q_OS_LINUX
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    QVERIFY(sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+    int cpu = 0;
+    while(cpu < CPU_SETSIZE && !CPU_ISSET(cpu, &allowed))
+        ++cpu;
+    QVERIFY(cpu < CPU_SETSIZE);
+
+    PoolConfig config = makeConfig("pinned", 2);
+    config.cpus = {cpu};
+    WorkerPool pool(config);
+
+    std::atomic<int> wrongCpu{0};
+    for(int i = 0; i < 32; ++i) {
+        pool.submit([&]() {
+            if(sched_getcpu() != cpu)
+                wrongCpu.fetch_add(1);
+        });
+    }
+    pool.waitForIdle();
+    QCOMPARE(wrongCpu.load(), 0);
+#else
+    QSKIP("CPU pinning is only supported on Linux");
+#endif
+}
+
+void TestExecutor::executorProvidesNamedPools()
+{
+    Executor &executor = Executor::instance();
+    QVERIFY(executor.pool(Executor::PREPROCESS));
+    QVERIFY(executor.pool(Executor::PARSE));
+    QVERIFY(executor.pool(Executor::POSTPROCESS));
+    QCOMPARE(executor.stats().size(), 3);
+
+    QTest::ignoreMessage(QtWarningMsg, "Executor has no pool named \"missing\"");
+    QVERIFY(!executor.pool("missing"));
+
+    QTest::ignoreMessage(QtWarningMsg, "Executor::configure called after pools were created");
+    QVERIFY(!executor.configure(Executor::defaultConfig()));
+}
+
+QTEST_APPLESS_MAIN(TestExecutor)
+
+#include "tst_executor.moc"
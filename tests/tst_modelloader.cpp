@@ -0,0 +1,189 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <QThread>
+
+#include <atomic>
+#include <mutex>
+
+#include "../model/modelloader.h"
+
+// Stand-in backend with configurable phase durations and failures
+class FakeBackend : public InferenceBackend
+{
+public:
+    int loadDelayMs = 0;
+    int compileDelayMs = 0;
+    int inferDelayMs = 0;
+    bool failCompile = false;
+    QList<int> batchSizes {1, 2};
+    int size = 64;
+    QList<int> inputSizes {64};
+
+    std::atomic_bool compiled{false};
+    std::mutex mutex;
+    QList<int> warmedUp;
+    QList<qsizetype> warmUpInputSizes;
+    QList<int> warmedUpSides;
+
+    bool load(QString *error) override {
+        Q_UNUSED(error);
+        QThread::msleep(loadDelayMs);
+        return true;
+    }
+
+    bool compile(QString *error) override {
+        QThread::msleep(compileDelayMs);
+        if(failCompile) {
+            if(error) *error = "fake compile error";
+            return false;
+        }
+        compiled = true;
+        return true;
+    }
+
+    bool infer(const float *input, int batch, InferenceOutput &output, QString *error) override {
+        if(!compiled) {
+            if(error) *error = "not compiled";
+            return false;
+        }
+        QThread::msleep(inferDelayMs);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            warmedUp.append(batch);
+            warmUpInputSizes.append(input ? qsizetype(batch) * 3 * inputSize() * inputSize() : 0);
+            warmedUpSides.append(size);
+        }
+        output.shape = {batch, 84, 8400};
+        output.data = QByteArray(qsizetype(batch) * 84 * 8400 * sizeof(float), 0);
+        return true;
+    }
+
+    QList<int> supportedBatchSizes() const override { return batchSizes; }
+    int inputSize() const override { return size; }
+    QList<int> supportedInputSizes() const override { return inputSizes; }
+    bool setInputSize(int side) override {
+        if(!inputSizes.contains(side))
+            return false;
+        size = side;
+        return true;
+    }
+};
+
+class TestModelLoader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void startReturnsBeforeModelIsReady();
+    void warmsUpEverySupportedBatchSize();
+    void warmsUpEverySupportedInputSize();
+    void reportsPhaseTimings();
+    void compileFailureIsReported();
+    void missingBackendFails();
+};
+
+void TestModelLoader::startReturnsBeforeModelIsReady()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->loadDelayMs = 200;
+    ModelLoader loader(backend);
+    QSignalSpy readySpy(&loader, &ModelLoader::ready);
+
+    QElapsedTimer timer;
+    timer.start();
+    loader.start();
+    QVERIFY(timer.elapsed() < 100);
+    QCOMPARE(loader.state(), ModelLoader::State::Loading);
+    QVERIFY(!loader.isReady());
+
+    QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 5000);
+    QCOMPARE(loader.state(), ModelLoader::State::Ready);
+}
+
+void TestModelLoader::warmsUpEverySupportedBatchSize()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->batchSizes = {1, 2, 4};
+    ModelLoader loader(backend);
+    QSignalSpy readySpy(&loader, &ModelLoader::ready);
+
+    loader.start();
+    QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 5000);
+
+    QCOMPARE(backend->warmedUp, QList<int>({1, 2, 4}));
+    QCOMPARE(backend->warmUpInputSizes.at(2), qsizetype(4 * 3 * 64 * 64));
+    QCOMPARE(loader.timings().warmUpMs.size(), 3);
+}
+
+void TestModelLoader::warmsUpEverySupportedInputSize()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->inputSizes = {32, 48, 64};
+    ModelLoader loader(backend);
+    QSignalSpy readySpy(&loader, &ModelLoader::ready);
+
+    loader.start();
+    QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 5000);
+
+    // Default size first, then the others; timings only for the default
+    QCOMPARE(backend->warmedUpSides, QList<int>({64, 64, 32, 32, 48, 48}));
+    QCOMPARE(backend->warmUpInputSizes.at(2), qsizetype(1 * 3 * 32 * 32));
+    QCOMPARE(loader.timings().warmUpMs.size(), 2);
+    QCOMPARE(backend->inputSize(), 64);
+}
+
+void TestModelLoader::reportsPhaseTimings()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->loadDelayMs = 20;
+    backend->compileDelayMs = 40;
+    backend->inferDelayMs = 30;
+    backend->batchSizes = {2};
+    ModelLoader loader(backend);
+    QSignalSpy readySpy(&loader, &ModelLoader::ready);
+
+    loader.start();
+    QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 5000);
+
+    const StartupTimings timings = readySpy.at(0).at(0).value<StartupTimings>();
+    QVERIFY(timings.loadMs >= 20.0);
+    QVERIFY(timings.compileMs >= 40.0);
+    QVERIFY(timings.firstInferenceMs >= 30.0);
+    QVERIFY(timings.totalMs >= timings.loadMs + timings.compileMs + timings.firstInferenceMs);
+    QCOMPARE(loader.timings().compileMs, timings.compileMs);
+}
+
+void TestModelLoader::compileFailureIsReported()
+{
+    auto backend = std::make_shared<FakeBackend>();
+    backend->failCompile = true;
+    ModelLoader loader(backend);
+    QSignalSpy failedSpy(&loader, &ModelLoader::failed);
+    QSignalSpy readySpy(&loader, &ModelLoader::ready);
+
+    loader.start();
+    QTRY_COMPARE_WITH_TIMEOUT(failedSpy.count(), 1, 5000);
+    QCOMPARE(loader.state(), ModelLoader::State::Failed);
+    QVERIFY(loader.errorString().contains("fake compile error"));
+    QCOMPARE(readySpy.count(), 0);
+    QVERIFY(backend->warmedUp.isEmpty());
+
+    // A retry after fixing the backend succeeds
+    backend->failCompile = false;
+    loader.start();
+    QTRY_COMPARE_WITH_TIMEOUT(readySpy.count(), 1, 5000);
+    QVERIFY(loader.isReady());
+}
+
+void TestModelLoader::missingBackendFails()
+{
+    ModelLoader loader(nullptr);
+    QSignalSpy failedSpy(&loader, &ModelLoader::failed);
+    loader.start();
+    QCOMPARE(failedSpy.count(), 1);
+    QCOMPARE(loader.state(), ModelLoader::State::Failed);
+}
+
+QTEST_GUILESS_MAIN(TestModelLoader)
+
+#include "tst_modelloader.moc"
@@ -0,0 +1,154 @@
+#include <QSignalSpy>
+#include <QTest>
+
+#include "../model/resolutioncontroller.h"
+
+// Batch of two frames costing frameMs each
+static StageLatency batch(double frameMs)
+{
+    StageLatency latency;
+    latency.frames = 2;
+    latency.preprocessMs = 0.2 * frameMs * 2;
+    latency.inferMs = 0.7 * frameMs * 2;
+    latency.parseMs = 0.1 * frameMs * 2;
+    return latency;
+}
+
+static ResolutionController::Options options()
+{
+    ResolutionController::Options options;
+    options.targetFps = 25.0;   // 40 ms per frame
+    options.smoothing = 0.5;
+    options.patience = 3;
+    options.cooldown = 2;
+    return options;
+}
+
+class TestResolutionController : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void startsAtLargestSize();
+    void stepsDownWhenOverBudget();
+    void singleSlowBatchDoesNotSwitch();
+    void stepsUpWhenLargerSizeFits();
+    void holdsSizeInsideHysteresisBand();
+    void restrictsToBackendSizes();
+};
+
+void TestResolutionController::startsAtLargestSize()
+{
+    ResolutionController controller;
+    QCOMPARE(controller.sizes(), QList<int>({320, 480, 640}));
+    QCOMPARE(controller.inputSize(), 640);
+
+    ResolutionController unsorted({640, 320, 320, 480}, options());
+    QCOMPARE(unsorted.sizes(), QList<int>({320, 480, 640}));
+    QCOMPARE(unsorted.inputSize(), 640);
+}
+
+void TestResolutionController::stepsDownWhenOverBudget()
+{
+    ResolutionController controller({320, 480, 640}, options());
+    QSignalSpy spy(&controller, &ResolutionController::resolutionChanged);
+
+    QCOMPARE(controller.report(batch(60.0)), 640);
+    QCOMPARE(controller.report(batch(60.0)), 640);
+    QCOMPARE(controller.report(batch(60.0)), 480);
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toInt(), 640);
+    QCOMPARE(spy.at(0).at(1).toInt(), 480);
+    QCOMPARE(spy.at(0).at(2).toDouble(), 60.0);
+
+    // Still too slow at 480 once the cooldown is over
+    for(int i = 0; i < 5; ++i)
+        controller.report(batch(50.0));
+    QCOMPARE(controller.inputSize(), 320);
+    // Nothing smaller to go to
+    for(int i = 0; i < 10; ++i)
+        controller.report(batch(50.0));
+    QCOMPARE(controller.inputSize(), 320);
+
+    const ResolutionStats stats = controller.stats();
+    QCOMPARE(stats.stepsDown, quint64(2));
+    QCOMPARE(stats.stepsUp, quint64(0));
+    QCOMPARE(stats.switches(), quint64(2));
+    QCOMPARE(stats.budgetMs, 40.0);
+    QCOMPARE(stats.samples, quint64(18));
+    QCOMPARE(stats.framesAtSize.value(640), quint64(6));
+    QCOMPARE(stats.framesAtSize.value(480), quint64(10));
+    QCOMPARE(stats.framesAtSize.value(320), quint64(20));
+}
+
+void TestResolutionController::singleSlowBatchDoesNotSwitch()
+{
+    ResolutionController controller({320, 480, 640}, options());
+    controller.report(batch(30.0));
+    controller.report(batch(30.0));
+    controller.report(batch(45.0));
+    controller.report(batch(30.0));
+    controller.report(batch(30.0));
+    QCOMPARE(controller.inputSize(), 640);
+    QCOMPARE(controller.stats().switches(), quint64(0));
+}
+
+void TestResolutionController::stepsUpWhenLargerSizeFits()
+{
+    ResolutionController controller({320, 480, 640}, options());
+    for(int i = 0; i < 3; ++i)
+        controller.report(batch(80.0));
+    QCOMPARE(controller.inputSize(), 480);
+    for(int i = 0; i < 5; ++i)
+        controller.report(batch(80.0));
+    QCOMPARE(controller.inputSize(), 320);
+
+    // Load goes away: 10 ms at 320 predicts 40 * 0.5625 = 22.5 ms at 480
+    QSignalSpy spy(&controller, &ResolutionController::resolutionChanged);
+    int steps = 0;
+    while(controller.inputSize() != 640 && steps++ < 50)
+        controller.report(batch(controller.inputSize() == 320 ? 10.0 : 16.0));
+    QCOMPARE(controller.inputSize(), 640);
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(spy.at(0).at(1).toInt(), 480);
+    QCOMPARE(spy.at(1).at(1).toInt(), 640);
+    QCOMPARE(controller.stats().stepsUp, quint64(2));
+}
+
+void TestResolutionController::holdsSizeInsideHysteresisBand()
+{
+    ResolutionController controller({320, 480, 640}, options());
+    for(int i = 0; i < 3; ++i)
+        controller.report(batch(60.0));
+    QCOMPARE(controller.inputSize(), 480);
+
+    // 25 ms at 480 fits the budget, but 640 would need ~44 ms
+    for(int i = 0; i < 30; ++i)
+        controller.report(batch(25.0));
+    QCOMPARE(controller.inputSize(), 480);
+    QCOMPARE(controller.stats().switches(), quint64(1));
+}
+
+void TestResolutionController::restrictsToBackendSizes()
+{
+    ResolutionController controller({320, 480, 640}, options());
+    for(int i = 0; i < 3; ++i)
+        controller.report(batch(60.0));
+    QCOMPARE(controller.inputSize(), 480);
+
+    controller.setSizes({480, 640});
+    QCOMPARE(controller.inputSize(), 480);
+    controller.setSizes({640});
+    QCOMPARE(controller.inputSize(), 640);
+    // A single size never switches
+    for(int i = 0; i < 10; ++i)
+        QCOMPARE(controller.report(batch(100.0)), 640);
+
+    QTest::ignoreMessage(QtWarningMsg, "ResolutionController needs at least one input size");
+    controller.setSizes({});
+    QCOMPARE(controller.sizes(), QList<int>({640}));
+}
+
+QTEST_APPLESS_MAIN(TestResolutionController)
+
+#include "tst_resolutioncontroller.moc"
@@ -0,0 +1,358 @@
+#include <QTest>
+#include <QThread>
+
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <utility>
+
+#include "../model/detectionworker.h"
+#include "../model/sharedring.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static constexpr int INPUT = 16;
+
+// Backend that returns one box per batch item, placed from the item's first
+// input value, so each result can be traced back to its frame.
+class FakeBackend : public InferenceBackend
+{
+public:
+    bool load(QString *) override { return true; }
+    bool compile(QString *) override { return true; }
+
+    bool infer(const float *input, int batch, InferenceOutput &output, QString *) override {
+        const int C = 6;
+        const int N = 4;
+        const size_t plane = 3 * size_t(INPUT) * INPUT;
+        output.shape = {batch, C, N};
+        output.data = QByteArray(qsizetype(batch) * C * N * sizeof(float), 0);
+        float *out = reinterpret_cast<float*>(output.data.data());
+        for(int b = 0; b < batch; ++b) {
+            float *item = out + b * C * N;
+            item[0 * N] = 8.f + input[b * plane];   // cx
+            item[1 * N] = 8.f;                       // cy
+            item[2 * N] = 4.f;                       // w
+            item[3 * N] = 4.f;                       // h
+            item[4 * N] = 0.9f;                      // class 0
+        }
+        return true;
+    }
+
+    QList<int> supportedBatchSizes() const override { return {1, 2}; }
+    int inputSize() const override { return INPUT; }
+};
+
+// Unique to this test process; children must use the parent's names
+static QString ringName(const char *role)
+{
+    return QString("/objectdetector-test-%1-%2").arg(qint64(getpid())).arg(role);
+}
+
+static bool produceFrame(SharedRing &ring, quint32 streamId, quint64 frameId)
+{
+    SharedRing::Slot slot = ring.acquireWrite(5000);
+    if(!slot.isValid())
+        return false;
+
+    SharedFrameHeader header;
+    header.frameId = frameId;
+    header.streamId = streamId;
+    header.inputSize = INPUT;
+    header.origW = INPUT;
+    header.origH = INPUT;
+    writeSharedFrameHeader(slot, header);
+
+    float *input = sharedFrameInput(slot);
+    std::fill(input, input + 3 * INPUT * INPUT, float(frameId % 8));
+    ring.commitWrite(slot, sharedFrameSlotSize(INPUT));
+    return true;
+}
+
+class TestSharedRing : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void slotsAreWrittenAndReadInPlace();
+    void closedRingStopsWritersAndDrainsReaders();
+    void deadReaderSlotIsRecovered();
+    void deadWriterSlotIsSkipped();
+    void workersProcessFramesFromProducers();
+    void crashedWorkerIsRestarted();
+    void stopDoesNotWaitForUndrainedResults();
+};
+
+void TestSharedRing::slotsAreWrittenAndReadInPlace()
+{
+    QString error;
+    auto ring = SharedRing::create(ringName("inplace"), 4, 64, &error);
+    QVERIFY2(ring, qPrintable(error));
+    auto reader = SharedRing::open(ringName("inplace"), &error);
+    QVERIFY2(reader, qPrintable(error));
+    QCOMPARE(reader->slotCount(), quint32(4));
+    QCOMPARE(reader->slotSize(), quint32(64));
+
+    for(int i = 0; i < 4; ++i) {
+        SharedRing::Slot slot = ring->tryAcquireWrite();
+        QVERIFY(slot.isValid());
+        QCOMPARE(slot.capacity, quint32(64));
+        std::memset(slot.data, 'a' + i, 10);
+        ring->commitWrite(slot, 10);
+    }
+    QVERIFY(!ring->tryAcquireWrite().isValid());
+
+    for(int i = 0; i < 4; ++i) {
+        SharedRing::Slot slot = reader->acquireRead(100);
+        QVERIFY(slot.isValid());
+        QCOMPARE(slot.size, quint32(10));
+        QCOMPARE(char(slot.data[9]), char('a' + i));
+        reader->releaseRead(slot);
+    }
+    QVERIFY(!reader->tryAcquireRead().isValid());
+    QVERIFY(ring->tryAcquireWrite().isValid());
+}
+
+void TestSharedRing::closedRingStopsWritersAndDrainsReaders()
+{
+    auto ring = SharedRing::create(ringName("close"), 2, 16);
+    QVERIFY(ring);
+    SharedRing::Slot slot = ring->tryAcquireWrite();
+    ring->commitWrite(slot, 1);
+    ring->close();
+
+    QVERIFY(ring->isClosed());
+    QVERIFY(!ring->acquireWrite(100).isValid());
+    SharedRing::Slot pending = ring->acquireRead(100);
+    QVERIFY(pending.isValid());
+    ring->releaseRead(pending);
+
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(!ring->acquireRead(5000).isValid());
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void TestSharedRing::deadReaderSlotIsRecovered()
+{
+#ifdef Q_OS_LINUX
+    const QString name = ringName("deadreader");
+    auto ring = SharedRing::create(name, 2, 16);
+    QVERIFY(ring);
+    for(int i = 0; i < 2; ++i) {
+        SharedRing::Slot slot = ring->tryAcquireWrite();
+        ring->commitWrite(slot, 1);
+    }
+
+    const pid_t child = fork();
+    if(child == 0) {
+        auto reader = SharedRing::open(name);
+        if(reader)
+            reader->tryAcquireRead();   // never released
+        _exit(0);
+    }
+    QVERIFY(child > 0);
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    SharedRing::Slot slot = ring->tryAcquireRead();
+    QVERIFY(slot.isValid());
+    ring->releaseRead(slot);
+    // Writers wrap around onto the slot still held by the dead reader
+    QVERIFY(!ring->tryAcquireWrite().isValid());
+
+    QCOMPARE(ring->recoverAbandoned(), 1);
+    QVERIFY(ring->tryAcquireWrite().isValid());
+#else
+    QSKIP("Process tests need Linux");
+#endif
+}
+
+void TestSharedRing::deadWriterSlotIsSkipped()
+{
+#ifdef Q_OS_LINUX
+    const QString name = ringName("deadwriter");
+    auto ring = SharedRing::create(name, 4, 16);
+    QVERIFY(ring);
+
+    const pid_t child = fork();
+    if(child == 0) {
+        auto writer = SharedRing::open(name);
+        if(writer)
+            writer->tryAcquireWrite();  // never committed
+        _exit(0);
+    }
+    QVERIFY(child > 0);
+    int status = 0;
+    waitpid(child, &status, 0);
+
+    SharedRing::Slot slot = ring->tryAcquireWrite();
+    QVERIFY(slot.isValid());
+    slot.data[0] = 42;
+    ring->commitWrite(slot, 1);
+    // Readers are stuck behind the uncommitted slot
+    QVERIFY(!ring->tryAcquireRead().isValid());
+
+    QCOMPARE(ring->recoverAbandoned(), 1);
+    SharedRing::Slot read = ring->tryAcquireRead();
+    QVERIFY(read.isValid());
+    QCOMPARE(int(read.data[0]), 42);
+    ring->releaseRead(read);
+#else
+    QSKIP("Process tests need Linux");
+#endif
+}
+
+void TestSharedRing::workersProcessFramesFromProducers()
+{
+#ifdef Q_OS_LINUX
+    QString error;
+    auto frames = SharedRing::create(ringName("frames"), 8, sharedFrameSlotSize(INPUT), &error);
+    QVERIFY2(frames, qPrintable(error));
+    auto results = SharedRing::create(ringName("results"), 16, sharedResultSlotSize(), &error);
+    QVERIFY2(results, qPrintable(error));
+
+    DetectionWorker::Config config;
+    config.frameRing = ringName("frames");
+    config.resultRing = ringName("results");
+    DetectionWorkerPool pool(config, 3, []() { return std::make_shared<FakeBackend>(); });
+    QVERIFY2(pool.start(&error), qPrintable(error));
+    QCOMPARE(pool.workerPids().size(), 3);
+
+    constexpr int PRODUCERS = 2;
+    constexpr int FRAMES = 100;
+    QList<pid_t> producers;
+    for(int p = 0; p < PRODUCERS; ++p) {
+        const pid_t producer = fork();
+        if(producer == 0) {
+            auto ring = SharedRing::open(config.frameRing);
+            bool ok = bool(ring);
+            for(int i = 0; ok && i < FRAMES; ++i)
+                ok = produceFrame(*ring, quint32(p), quint64(i));
+            _exit(ok ? 0 : 1);
+        }
+        QVERIFY(producer > 0);
+        producers.append(producer);
+    }
+
+    std::set<std::pair<quint32, quint64>> seen;
+    std::set<qint32> workers;
+    bool decoded = true;
+    QElapsedTimer timer;
+    timer.start();
+    while(int(seen.size()) < PRODUCERS * FRAMES && timer.elapsed() < 20000) {
+        SharedRing::Slot slot = results->acquireRead(100);
+        if(!slot.isValid())
+            continue;
+        SharedResultHeader header;
+        const QList<Detection> detections = readSharedDetections(slot, &header);
+        results->releaseRead(slot);
+
+        QCOMPARE(header.status, qint32(SharedResultHeader::Ok));
+        QVERIFY(seen.insert({header.streamId, header.frameId}).second);
+        workers.insert(header.workerPid);
+        if(detections.size() != 1 || detections[0].rect.x() != 6 + int(header.frameId % 8))
+            decoded = false;
+    }
+
+    for(pid_t producer : producers) {
+        int status = 0;
+        waitpid(producer, &status, 0);
+        QVERIFY(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    QCOMPARE(int(seen.size()), PRODUCERS * FRAMES);
+    QVERIFY(decoded);
+    QVERIFY(workers.size() >= 1);
+
+    pool.stop();
+    QVERIFY(pool.workerPids().isEmpty());
+    QVERIFY(frames->isClosed());
+#else
+    QSKIP("Process tests need Linux");
+#endif
+}
+
+void TestSharedRing::crashedWorkerIsRestarted()
+{
+#ifdef Q_OS_LINUX
+    auto frames = SharedRing::create(ringName("crashframes"), 4, sharedFrameSlotSize(INPUT));
+    auto results = SharedRing::create(ringName("crashresults"), 16, sharedResultSlotSize());
+    QVERIFY(frames && results);
+
+    DetectionWorker::Config config;
+    config.frameRing = ringName("crashframes");
+    config.resultRing = ringName("crashresults");
+    DetectionWorkerPool pool(config, 1, []() { return std::make_shared<FakeBackend>(); });
+    QVERIFY(pool.start());
+    const qint64 first = pool.workerPids().at(0);
+
+    kill(pid_t(first), SIGKILL);
+    int restarted = 0;
+    for(int i = 0; i < 500 && restarted == 0; ++i) {
+        restarted = pool.supervise();
+        if(restarted == 0)
+            QThread::msleep(10);
+    }
+    QCOMPARE(restarted, 1);
+    QCOMPARE(pool.restartCount(), 1);
+    QCOMPARE(pool.workerPids().size(), 1);
+    QVERIFY(pool.workerPids().at(0) != first);
+
+    for(int i = 0; i < 10; ++i)
+        QVERIFY(produceFrame(*frames, 0, quint64(i)));
+    int received = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while(received < 10 && timer.elapsed() < 10000) {
+        SharedRing::Slot slot = results->acquireRead(100);
+        if(!slot.isValid())
+            continue;
+        results->releaseRead(slot);
+        ++received;
+    }
+    QCOMPARE(received, 10);
+    pool.stop();
+#else
+    QSKIP("Process tests need Linux");
+#endif
+}
+
+void TestSharedRing::stopDoesNotWaitForUndrainedResults()
+{
+#ifdef Q_OS_LINUX
+    auto frames = SharedRing::create(ringName("stopframes"), 4, sharedFrameSlotSize(INPUT));
+    auto results = SharedRing::create(ringName("stopresults"), 2, sharedResultSlotSize());
+    QVERIFY(frames && results);
+
+    DetectionWorker::Config config;
+    config.frameRing = ringName("stopframes");
+    config.resultRing = ringName("stopresults");
+    config.pollMs = 20;
+    DetectionWorkerPool pool(config, 1, []() { return std::make_shared<FakeBackend>(); });
+    QVERIFY(pool.start());
+
+    // Nobody reads the results, so the result ring fills up halfway through
+    for(int i = 0; i < 4; ++i)
+        QVERIFY(produceFrame(*frames, 0, quint64(i)));
+    // Let the worker fill the result ring and block on the next slot
+    QThread::msleep(200);
+
+    QElapsedTimer timer;
+    timer.start();
+    pool.stop(10000);
+    QVERIFY(timer.elapsed() < 5000);
+    QVERIFY(pool.workerPids().isEmpty());
+
+    SharedRing::Slot slot = results->tryAcquireRead();
+    QVERIFY(slot.isValid());
+    results->releaseRead(slot);
+#else
+    QSKIP("Process tests need Linux");
+#endif
+}
+
+QTEST_APPLESS_MAIN(TestSharedRing)
+
+#include "tst_sharedring.moc"
@@ -1,4 +1,6 @@
+#include <QSignalSpy>
 #include <QTest>
+#include <random>
 #include "../model/yoloparser.h"
 
 /** Uncomment the following lines to enable debug logging for this test cases. **/
@@ -25,9 +27,53 @@ private slots:
     void overlappingBoxesAreSuppressed();
     void invalidBatchIndexReturnsEmpty();
     void nullDataReturnsEmpty();
+    void specializedMatchesGeneric();
+    void anchorMajorMatchesChannelMajor();
+    void paddedStridesAreDecodedInPlace();
+    void shapeFromTensorDetectsLayout();
+    void classFilterReadsOnlyAllowedClasses();
+    void regionMaskRejectsOutsideCenters();
+    void candidateCapsBoundNms();
+    void rejectedBatchStillFinishes();
+    void benchmarkParse_data();
+    void benchmarkParse();
 
 };
 
+// Builds a [1, 4 + classes, boxes] tensor with a few confident, spread out
+// boxes over uniform low scores, roughly what a real frame looks like.
+static std::vector<float> makeSyntheticTensor(int classes, int boxes)
+{
+    const int C = 4 + classes;
+    std::vector<float> data(size_t(C) * boxes);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> pos(0.f, 640.f);
+    std::uniform_real_distribution<float> size(10.f, 120.f);
+    std::uniform_real_distribution<float> low(0.f, 0.3f);
+
+    for(int i = 0; i < boxes; ++i) {
+        data[0 * size_t(boxes) + i] = pos(rng);
+        data[1 * size_t(boxes) + i] = pos(rng);
+        data[2 * size_t(boxes) + i] = size(rng);
+        data[3 * size_t(boxes) + i] = size(rng);
+    }
+    for(size_t i = 4 * size_t(boxes); i < data.size(); ++i)
+        data[i] = low(rng);
+    for(int i = 0; i < boxes; i += 97)
+        data[(4 + size_t(i % classes)) * boxes + i] = 0.9f;
+    return data;
+}
+
+// Re-lays a dense [C, N] tensor as [N, rowStride] with C <= rowStride
+static std::vector<float> toAnchorMajor(const std::vector<float> &src, int C, int N, int rowStride)
+{
+    std::vector<float> dst(size_t(N) * rowStride, -1.f);
+    for(int c = 0; c < C; ++c)
+        for(int n = 0; n < N; ++n)
+            dst[size_t(n) * rowStride + c] = src[size_t(c) * N + n];
+    return dst;
+}
+
 TestYoloParser::TestYoloParser() {}
 
 TestYoloParser::~TestYoloParser() {}
@@ -53,7 +99,7 @@ void TestYoloParser::singleHighConfidenceDetection()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 1);
     QCOMPARE(detections[0].classId, 0);
     QCOMPARE(detections[0].label, QString("person"));
@@ -83,7 +129,7 @@ void TestYoloParser::detectionBelowConfidenceIsIgnored()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 0);
 }
 
@@ -108,7 +154,7 @@ void TestYoloParser::highestClassScoreIsSelected()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 1);
     QCOMPARE(detections[0].classId, 1);
     QCOMPARE(detections[0].label, QString("bicycle"));
@@ -135,7 +181,7 @@ void TestYoloParser::emptyOutputProducesNoDetections()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 0);
 }
 
@@ -171,7 +217,7 @@ void TestYoloParser::overlappingBoxesAreSuppressed()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(data, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 1); // Only one box should remain after NMS
 }
 
@@ -189,7 +235,7 @@ void TestYoloParser::invalidBatchIndexReturnsEmpty()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(data, shape, letterbox, 5, 0.25f, 0.5f, 640, 480); // Invalid batch index
+    auto detections = parser.parse(data, shape, letterbox, 5, 0.25f, 0.5f); // Invalid batch index
     QCOMPARE(detections.size(), 0);
 }
 
@@ -205,10 +251,313 @@ void TestYoloParser::nullDataReturnsEmpty()
     letterbox.origW = 640;
     letterbox.origH = 480;
 
-    auto detections = parser.parse(nullptr, shape, letterbox, 0, 0.25f, 0.5f, 640, 480);
+    auto detections = parser.parse(nullptr, shape, letterbox, 0, 0.25f, 0.5f);
     QCOMPARE(detections.size(), 0);
 }
 
+void TestYoloParser::specializedMatchesGeneric()
+{
+    YoloParser::TensorShape shape = {1, 84, 8400};
+    QVERIFY(YoloParser::hasSpecializedDecoder(shape));
+    QVERIFY(!YoloParser::hasSpecializedDecoder({1, 84, 100}));
+
+    std::vector<float> data = makeSyntheticTensor(80, 8400);
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 640;
+
+    auto specialized = YoloParser::parse(data.data(), shape, letterbox, 0);
+    auto generic = YoloParser::parseGeneric(data.data(), shape, letterbox, 0);
+    QVERIFY(!specialized.isEmpty());
+    QCOMPARE(specialized.size(), generic.size());
+    for(int i = 0; i < specialized.size(); ++i) {
+        QCOMPARE(specialized[i].classId, generic[i].classId);
+        QCOMPARE(specialized[i].rect, generic[i].rect);
+        QCOMPARE(specialized[i].score, generic[i].score);
+    }
+}
+
+void TestYoloParser::anchorMajorMatchesChannelMajor()
+{
+    YoloParser::TensorShape shape = {1, 84, 8400};
+    std::vector<float> data = makeSyntheticTensor(80, 8400);
+    std::vector<float> transposed = toAnchorMajor(data, 84, 8400, 84);
+
+    YoloParser::TensorShape anchorMajor = shape;
+    anchorMajor.channelStride = 1;
+    anchorMajor.boxStride = 84;
+    QVERIFY(anchorMajor.layout() == YoloParser::TensorLayout::AnchorMajor);
+    QVERIFY(YoloParser::hasSpecializedDecoder(anchorMajor));
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 640;
+
+    auto expected = YoloParser::parse(data.data(), shape, letterbox, 0);
+    auto specialized = YoloParser::parse(transposed.data(), anchorMajor, letterbox, 0);
+    auto generic = YoloParser::parseGeneric(transposed.data(), anchorMajor, letterbox, 0);
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(specialized.size(), expected.size());
+    QCOMPARE(generic.size(), expected.size());
+    for(int i = 0; i < expected.size(); ++i) {
+        QCOMPARE(specialized[i].classId, expected[i].classId);
+        QCOMPARE(specialized[i].rect, expected[i].rect);
+        QCOMPARE(generic[i].classId, expected[i].classId);
+        QCOMPARE(generic[i].rect, expected[i].rect);
+    }
+}
+
+void TestYoloParser::paddedStridesAreDecodedInPlace()
+{
+    // Two boxes, 6 channels, anchor-major rows padded to 8 floats and a
+    // second batch item after the first one.
+    const float padded[] = {
+        // batch 0
+        320.f, 240.f, 100.f, 80.f, 0.1f, 0.2f, -1.f, -1.f,
+        100.f, 100.f,  50.f, 50.f, 0.1f, 0.1f, -1.f, -1.f,
+        // batch 1
+        320.f, 240.f, 100.f, 80.f, 0.1f, 0.1f, -1.f, -1.f,
+        100.f, 100.f,  50.f, 50.f, 0.3f, 0.9f, -1.f, -1.f,
+    };
+    YoloParser::TensorShape shape = {2, 6, 2, 16, 1, 8};
+    QVERIFY(shape.layout() == YoloParser::TensorLayout::AnchorMajor);
+    QCOMPARE(shape.extent(), qint64(30));
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 480;
+
+    auto batch0 = YoloParser::parse(padded, shape, letterbox, 0, 0.15f, 0.5f);
+    QCOMPARE(batch0.size(), 1);
+    QCOMPARE(batch0[0].classId, 1);
+    QCOMPARE(batch0[0].rect, QRect(270, 200, 100, 80));
+
+    auto batch1 = YoloParser::parse(padded, shape, letterbox, 1, 0.15f, 0.5f);
+    QCOMPARE(batch1.size(), 1);
+    QCOMPARE(batch1[0].classId, 1);
+    QCOMPARE(batch1[0].rect, QRect(75, 75, 50, 50));
+
+    // Neither axis contiguous: C stride 2, N stride 12
+    const float strided[] = {
+        320.f, 0.f, 240.f, 0.f, 100.f, 0.f, 80.f, 0.f, 0.1f, 0.f, 0.7f, 0.f,
+    };
+    YoloParser::TensorShape odd = {1, 6, 1, 12, 2, 12};
+    QVERIFY(odd.layout() == YoloParser::TensorLayout::Strided);
+    auto detections = YoloParser::parse(strided, odd, letterbox, 0, 0.25f, 0.5f);
+    QCOMPARE(detections.size(), 1);
+    QCOMPARE(detections[0].classId, 1);
+}
+
+void TestYoloParser::shapeFromTensorDetectsLayout()
+{
+    const int channelMajorDims[3] = {2, 84, 8400};
+    const qint64 channelMajorStrides[3] = {84 * 8400, 8400, 1};
+    auto channelMajor = YoloParser::shapeFromTensor(channelMajorDims, channelMajorStrides);
+    QCOMPARE(channelMajor.channels, 84);
+    QCOMPARE(channelMajor.boxes, 8400);
+    QVERIFY(channelMajor.layout() == YoloParser::TensorLayout::ChannelMajor);
+
+    const int anchorMajorDims[3] = {2, 8400, 84};
+    const qint64 anchorMajorStrides[3] = {84 * 8400, 84, 1};
+    auto anchorMajor = YoloParser::shapeFromTensor(anchorMajorDims, anchorMajorStrides);
+    QCOMPARE(anchorMajor.channels, 84);
+    QCOMPARE(anchorMajor.boxes, 8400);
+    QVERIFY(anchorMajor.layout() == YoloParser::TensorLayout::AnchorMajor);
+
+    // [B, C, N] dims whose memory is actually anchor-major
+    const qint64 transposedStrides[3] = {84 * 8400, 1, 84};
+    auto transposed = YoloParser::shapeFromTensor(channelMajorDims, transposedStrides);
+    QVERIFY(transposed.layout() == YoloParser::TensorLayout::AnchorMajor);
+}
+
+void TestYoloParser::classFilterReadsOnlyAllowedClasses()
+{
+    YoloParser::TensorShape shape = {1,7,2};
+
+    float data[] = {
+        // cx, cy, w, h
+        100.f, 400.f,
+        100.f, 400.f,
+         50.f,  50.f,
+         50.f,  50.f,
+        // class 0 scores
+        0.9f, 0.1f,
+        // class 1 scores
+        0.6f, 0.1f,
+        // class 2 scores
+        0.1f, 0.5f
+    };
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 640;
+
+    DetectionFilter filter;
+    filter.allowClass(1);
+    filter.allowClass(2, 0.6f);
+
+    // Box 0 is reported as class 1 even though class 0 scores higher;
+    // box 1 fails the class 2 threshold.
+    auto detections = YoloParser::parse(data, shape, letterbox, 0, 0.25f, 0.5f, &filter);
+    QCOMPARE(detections.size(), 1);
+    QCOMPARE(detections[0].classId, 1);
+
+    filter.allowClass(2, 0.4f);
+    detections = YoloParser::parse(data, shape, letterbox, 0, 0.25f, 0.5f, &filter);
+    QCOMPARE(detections.size(), 2);
+}
+
+void TestYoloParser::regionMaskRejectsOutsideCenters()
+{
+    YoloParser::TensorShape shape = {1,6,2};
+
+    float data[] = {
+        // cx, cy, w, h
+        100.f, 500.f,
+        100.f, 500.f,
+         50.f,  50.f,
+         50.f,  50.f,
+        // class 0 scores
+        0.9f, 0.9f,
+        // class 1 scores
+        0.1f, 0.1f
+    };
+
+    // 1280x1280 frame letterboxed into 640x640
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.scale = 0.5f;
+    letterbox.origW = 1280;
+    letterbox.origH = 1280;
+
+    DetectionFilter filter;
+    QVERIFY(filter.isEmpty());
+    filter.addRegion({QPointF(0.0, 0.0), QPointF(0.5, 0.0),
+                      QPointF(0.5, 0.5), QPointF(0.0, 0.5)});
+    QVERIFY(filter.hasRegions());
+    QVERIFY(filter.containsNormalized(0.25f, 0.25f));
+    QVERIFY(!filter.containsNormalized(0.75f, 0.25f));
+
+    auto detections = YoloParser::parse(data, shape, letterbox, 0, 0.25f, 0.5f, &filter);
+    QCOMPARE(detections.size(), 1);
+    QCOMPARE(detections[0].rect, QRect(150, 150, 100, 100));
+}
+
+void TestYoloParser::candidateCapsBoundNms()
+{
+    // 400 well separated boxes over two classes, all above threshold
+    const int N = 400;
+    YoloParser::TensorShape shape = {1, 6, N};
+    std::vector<float> data(size_t(6) * N);
+    for(int i = 0; i < N; ++i) {
+        data[0 * N + i] = 8.f + (i % 20) * 30.f;
+        data[1 * N + i] = 8.f + (i / 20) * 30.f;
+        data[2 * N + i] = 10.f;
+        data[3 * N + i] = 10.f;
+        data[(4 + i % 2) * N + i] = 0.5f + float(i) / (2 * N);
+    }
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 640;
+
+    ParseStats stats;
+    const DecodeLimits unlimited {0, 0, 0};
+    auto all = YoloParser::parse(data.data(), shape, letterbox, 0, 0.25f, 0.5f,
+                                 nullptr, unlimited, &stats);
+    QCOMPARE(all.size(), N);
+    QCOMPARE(stats.candidates, N);
+    QCOMPARE(stats.truncatedCandidates, 0);
+
+    auto defaults = YoloParser::parse(data.data(), shape, letterbox, 0, 0.25f, 0.5f,
+                                      nullptr, DecodeLimits(), &stats);
+    QCOMPARE(defaults.size(), MAX_DETECTIONS);
+    QCOMPARE(stats.truncatedDetections, N - MAX_DETECTIONS);
+
+    DecodeLimits limits;
+    limits.maxCandidates = 100;
+    limits.maxCandidatesPerClass = 30;
+    limits.maxDetections = 50;
+    auto capped = YoloParser::parse(data.data(), shape, letterbox, 0, 0.25f, 0.5f,
+                                    nullptr, limits, &stats);
+    QCOMPARE(stats.candidates, N);
+    // 300 by the global cap, then 20 per class by the per-class cap
+    QCOMPARE(stats.truncatedCandidates, 340);
+    QCOMPARE(stats.truncatedDetections, 10);
+    QCOMPARE(capped.size(), 50);
+
+    // The survivors are the highest scoring boxes
+    float minScore = 1.f;
+    for(const Detection &d : capped)
+        minScore = std::min(minScore, d.score);
+    QVERIFY(minScore >= 0.5f + float(N - 60) / (2 * N));
+}
+
+void TestYoloParser::rejectedBatchStillFinishes()
+{
+    YoloParser parser;
+    QSignalSpy finished(&parser, &YoloParser::parsingFinished);
+    const QVector<YoloParser::LetterboxInfo> letterbox {YoloParser::letterboxFor(640, 480)};
+
+    // Blob holds fewer floats than the shape needs
+    parser.parseBatch(QByteArray(16, 0), {1, 84, 8400}, letterbox);
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(finished.at(0).at(0).toDouble(), 0.0);
+
+    // No room for a class score
+    parser.parseBatch(QByteArray(4 * 8400 * int(sizeof(float)), 0), {1, 4, 8400}, letterbox);
+    QCOMPARE(finished.count(), 2);
+}
+
+void TestYoloParser::benchmarkParse_data()
+{
+    QTest::addColumn<int>("classes");
+    QTest::addColumn<int>("boxes");
+    QTest::addColumn<bool>("specialized");
+    QTest::addColumn<bool>("anchorMajor");
+
+    QTest::newRow("80x8400 specialized")  << 80 << 8400 << true << false;
+    QTest::newRow("80x8400 generic")      << 80 << 8400 << false << false;
+    QTest::newRow("20x8400 specialized")  << 20 << 8400 << true << false;
+    QTest::newRow("20x8400 generic")      << 20 << 8400 << false << false;
+    QTest::newRow("1x33600 specialized")  << 1 << 33600 << true << false;
+    QTest::newRow("1x33600 generic")      << 1 << 33600 << false << false;
+    QTest::newRow("80x8400 anchor-major specialized") << 80 << 8400 << true << true;
+    QTest::newRow("80x8400 anchor-major generic")     << 80 << 8400 << false << true;
+}
+
+void TestYoloParser::benchmarkParse()
+{
+    QFETCH(int, classes);
+    QFETCH(int, boxes);
+    QFETCH(bool, specialized);
+    QFETCH(bool, anchorMajor);
+
+    YoloParser::TensorShape shape = {1, 4 + classes, boxes};
+    std::vector<float> data = makeSyntheticTensor(classes, boxes);
+    if(anchorMajor) {
+        data = toAnchorMajor(data, 4 + classes, boxes, 4 + classes);
+        shape.channelStride = 1;
+        shape.boxStride = 4 + classes;
+    }
+
+    YoloParser::LetterboxInfo letterbox;
+    letterbox.origW = 640;
+    letterbox.origH = 640;
+
+    QList<Detection> detections;
+    if(specialized) {
+        QBENCHMARK {
+            detections = YoloParser::parse(data.data(), shape, letterbox, 0);
+        }
+    } else {
+        QBENCHMARK {
+            detections = YoloParser::parseGeneric(data.data(), shape, letterbox, 0);
+        }
+    }
+    QVERIFY(!detections.isEmpty());
+}
+
 QTEST_APPLESS_MAIN(TestYoloParser)
 
 #include "tst_yoloparser.moc"
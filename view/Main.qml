@@ -75,6 +75,23 @@ ApplicationWindow {
         }
     }
 
+    Rectangle {
+        anchors.centerIn: parent
+        visible: !controller.modelReady
+        color: "#99000000"
+        radius: 6
+        width: loadingText.implicitWidth + 24
+        height: 40
+
+        Text {
+            id: loadingText
+            anchors.centerIn: parent
+            text: controller.startupTime === "" ? qsTr("Loading model...") : controller.startupTime
+            font.pixelSize: 14
+            color: "white"
+        }
+    }
+
     Column {
         id: perfOverlay
         anchors.bottom: parent.bottom
@@ -109,6 +126,50 @@ ApplicationWindow {
                 color: "cyan"
             }
         }
+
+        Rectangle {
+            color: "#66000000"
+            radius: 6
+            width: 200
+            height: 40
+            visible: controller.modelReady
+
+            Text {
+                anchors.centerIn: parent
+                text: controller.startupTime
+                font.pixelSize: 12
+                color: "white"
+            }
+        }
+
+        Rectangle {
+            color: "#66000000"
+            radius: 6
+            width: 200
+            height: 40
+
+            Text {
+                anchors.centerIn: parent
+                text: "Truncated: " + controller.truncatedCandidates
+                font.pixelSize: 14
+                color: controller.truncatedCandidates > 0 ? "orange" : "white"
+            }
+        }
+
+        Rectangle {
+            color: "#66000000"
+            radius: 6
+            width: 200
+            height: 40
+            visible: controller.modelReady
+
+            Text {
+                anchors.centerIn: parent
+                text: controller.inputResolution
+                font.pixelSize: 14
+                color: "white"
+            }
+        }
     }
 
     Component.onCompleted: {
@@ -125,36 +186,12 @@ ApplicationWindow {
         color: "transparent"
     }
 
-    Item {
+    DetectionOverlay {
         anchors.fill: videoOutput1
-
-        Repeater {
-            model: controller.detections
-
-            Rectangle {
-                // Map model-space → screen-space
-                x: modelData.rect.x * videoOutput1.width / modelData.origW + videoOutput1.contentRect.x
-                y: modelData.rect.y * videoOutput1.height / modelData.origH + videoOutput1.contentRect.y
-                width: modelData.rect.width * videoOutput1.width / modelData.origW
-                height: modelData.rect.height * videoOutput1.height / modelData.origH
-                onWidthChanged: console.log("Width changed to", width)
-                onHeightChanged: console.log("Height changed to", height)
-                onXChanged: console.log("X changed to", x)
-                onYChanged: console.log("Y changed to", y)
-
-                color: "transparent"
-                border.color: "red"
-                border.width: 3
-
-                Text {
-                    text: modelData.label
-                    color: "lime"
-                    font.pixelSize: 14
-                    anchors.bottom: parent.bottom
-                    anchors.right: parent.right
-                    anchors.margins: 4
-                }
-            }
-        }
+        contentRect: videoOutput1.contentRect
+        detections: controller.detections
+        boxColor: "red"
+        labelColor: "lime"
+        lineWidth: 3
     }
 }
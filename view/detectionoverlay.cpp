@@ -0,0 +1,292 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#include "detectionoverlay.h"
+
+#include <QFont>
+#include <QFontMetricsF>
+#include <QPainter>
+#include <QQuickWindow>
+#include <QSGFlatColorMaterial>
+#include <QSGGeometryNode>
+#include <QSGTexture>
+#include <QSGTextureMaterial>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int LABEL_PIXEL_SIZE = 14;
+constexpr qreal LABEL_MARGIN = 4.0;
+constexpr int VERTICES_PER_BOX = 24;   // 4 edges x 2 triangles
+constexpr int VERTICES_PER_GLYPH = 6;  // 2 triangles
+
+class OverlayNode : public QSGNode
+{
+public:
+    OverlayNode()
+    {
+        boxes.setGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 0));
+        boxes.geometry()->setDrawingMode(QSGGeometry::DrawTriangles);
+        boxes.setFlag(QSGNode::OwnsGeometry);
+        boxes.setFlag(QSGNode::OwnedByParent, false);
+        boxes.setMaterial(&boxMaterial);
+        appendChildNode(&boxes);
+
+        labels.setGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_TexturedPoint2D(), 0));
+        labels.geometry()->setDrawingMode(QSGGeometry::DrawTriangles);
+        labels.setFlag(QSGNode::OwnsGeometry);
+        labels.setFlag(QSGNode::OwnedByParent, false);
+        labels.setMaterial(&labelMaterial);
+        appendChildNode(&labels);
+    }
+
+    ~OverlayNode() override
+    {
+        removeAllChildNodes();
+        delete atlas;
+    }
+
+    QSGGeometryNode boxes;
+    QSGGeometryNode labels;
+    QSGFlatColorMaterial boxMaterial;
+    QSGTextureMaterial labelMaterial;
+    QSGTexture *atlas = nullptr;
+};
+
+// Grows the vertex buffer when needed; it never shrinks so steady scenes
+// keep writing into the same allocation.
+void reserveVertices(QSGGeometry *geometry, int count)
+{
+    if(geometry->vertexCount() < count)
+        geometry->allocate(count);
+}
+
+void quad(QSGGeometry::Point2D *&v, float x0, float y0, float x1, float y1)
+{
+    (v++)->set(x0, y0); (v++)->set(x1, y0); (v++)->set(x0, y1);
+    (v++)->set(x1, y0); (v++)->set(x1, y1); (v++)->set(x0, y1);
+}
+
+void texturedQuad(QSGGeometry::TexturedPoint2D *&v, const QRectF &r, const QRectF &uv)
+{
+    const float x0 = r.left(), y0 = r.top(), x1 = r.right(), y1 = r.bottom();
+    const float u0 = uv.left(), v0 = uv.top(), u1 = uv.right(), v1 = uv.bottom();
+    (v++)->set(x0, y0, u0, v0); (v++)->set(x1, y0, u1, v0); (v++)->set(x0, y1, u0, v1);
+    (v++)->set(x1, y0, u1, v0); (v++)->set(x1, y1, u1, v1); (v++)->set(x0, y1, u0, v1);
+}
+
+} // namespace
+
+DetectionOverlay::DetectionOverlay(QQuickItem *parent)
+    : QQuickItem(parent)
+{
+    setFlag(ItemHasContents, true);
+    buildGlyphAtlas();
+}
+
+/**
+ * @brief Copies the fields used for drawing out of the controller's list.
+ * Geometry is rebuilt later on the render thread.
+ * @param detections, list of maps with rect, label, origW and origH
+ */
+void DetectionOverlay::setDetections(const QVariantList &detections)
+{
+    m_detections = detections;
+    m_boxes.clear();
+    m_boxes.reserve(detections.size());
+    for(const QVariant &v : detections) {
+        const QVariantMap map = v.toMap();
+        Box box;
+        box.rect = map.value("rect").toRect();
+        box.label = map.value("label").toString();
+        box.origW = map.value("origW").toInt();
+        box.origH = map.value("origH").toInt();
+        if(box.origW <= 0 || box.origH <= 0) continue;
+        m_boxes.push_back(box);
+    }
+    emit detectionsChanged();
+    update();
+}
+
+void DetectionOverlay::setContentRect(const QRectF &rect)
+{
+    if(m_contentRect == rect) return;
+    m_contentRect = rect;
+    emit contentRectChanged();
+    update();
+}
+
+void DetectionOverlay::setBoxColor(const QColor &color)
+{
+    if(m_boxColor == color) return;
+    m_boxColor = color;
+    m_colorsDirty = true;
+    emit boxColorChanged();
+    update();
+}
+
+void DetectionOverlay::setLabelColor(const QColor &color)
+{
+    if(m_labelColor == color) return;
+    m_labelColor = color;
+    buildGlyphAtlas();
+    emit labelColorChanged();
+    update();
+}
+
+void DetectionOverlay::setLineWidth(qreal width)
+{
+    if(qFuzzyCompare(m_lineWidth, width)) return;
+    m_lineWidth = width;
+    emit lineWidthChanged();
+    update();
+}
+
+/**
+ * @brief Renders printable ASCII into a single image in the label colour.
+ */
+void DetectionOverlay::buildGlyphAtlas()
+{
+    QFont font;
+    font.setPixelSize(LABEL_PIXEL_SIZE);
+    const QFontMetricsF fm(font);
+
+    constexpr int first = 32;
+    constexpr int last = 126;
+    constexpr int columns = 16;
+    const int rows = (last - first + columns) / columns;
+
+    qreal cellW = 0;
+    for(int c = first; c <= last; ++c)
+        cellW = std::max(cellW, fm.horizontalAdvance(QChar(c)));
+    const int cellWidth = int(std::ceil(cellW)) + 2;
+    const int cellHeight = int(std::ceil(fm.height())) + 2;
+
+    m_atlas = QImage(columns * cellWidth, rows * cellHeight, QImage::Format_RGBA8888_Premultiplied);
+    m_atlas.fill(Qt::transparent);
+    m_glyphs.clear();
+
+    QPainter painter(&m_atlas);
+    painter.setFont(font);
+    painter.setPen(m_labelColor);
+    for(int c = first; c <= last; ++c) {
+        const int index = c - first;
+        const int cx = (index % columns) * cellWidth;
+        const int cy = (index / columns) * cellHeight;
+        painter.drawText(QPointF(cx + 1, cy + 1 + fm.ascent()), QString(QChar(c)));
+
+        Glyph glyph;
+        glyph.advance = fm.horizontalAdvance(QChar(c));
+        glyph.size = QSizeF(cellWidth, cellHeight);
+        glyph.uv = QRectF(qreal(cx) / m_atlas.width(),
+                          qreal(cy) / m_atlas.height(),
+                          qreal(cellWidth) / m_atlas.width(),
+                          qreal(cellHeight) / m_atlas.height());
+        m_glyphs.insert(QChar(c), glyph);
+    }
+    painter.end();
+    m_colorsDirty = true;
+}
+
+/**
+ * @brief Rebuilds both vertex buffers from the current boxes.
+ * Runs on the render thread while the GUI thread is blocked.
+ */
+QSGNode *DetectionOverlay::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
+{
+    Q_UNUSED(data);
+    auto *node = static_cast<OverlayNode*>(oldNode);
+    if(!node)
+        node = new OverlayNode();
+
+    if(m_colorsDirty || !node->atlas) {
+        node->boxMaterial.setColor(m_boxColor);
+        node->boxes.markDirty(QSGNode::DirtyMaterial);
+
+        delete node->atlas;
+        node->atlas = window()->createTextureFromImage(m_atlas);
+        node->labelMaterial.setTexture(node->atlas);
+        node->labelMaterial.setFiltering(QSGTexture::Linear);
+        node->labels.markDirty(QSGNode::DirtyMaterial);
+        m_colorsDirty = false;
+    }
+
+    const QRectF area = m_contentRect.isEmpty() ? QRectF(0, 0, width(), height()) : m_contentRect;
+    const float lw = float(m_lineWidth);
+
+    int glyphCount = 0;
+    for(const Box &box : m_boxes)
+        glyphCount += int(box.label.size());
+
+    QSGGeometry *boxGeometry = node->boxes.geometry();
+    reserveVertices(boxGeometry, int(m_boxes.size()) * VERTICES_PER_BOX);
+    QSGGeometry *labelGeometry = node->labels.geometry();
+    reserveVertices(labelGeometry, glyphCount * VERTICES_PER_GLYPH);
+
+    QSGGeometry::Point2D *bv = boxGeometry->vertexDataAsPoint2D();
+    QSGGeometry::TexturedPoint2D *lv = labelGeometry->vertexDataAsTexturedPoint2D();
+    const QSGGeometry::Point2D *bvEnd = bv + boxGeometry->vertexCount();
+    const QSGGeometry::TexturedPoint2D *lvEnd = lv + labelGeometry->vertexCount();
+
+    for(const Box &box : m_boxes) {
+        // Map model-space -> screen-space
+        const float sx = float(area.width() / box.origW);
+        const float sy = float(area.height() / box.origH);
+        const float x0 = float(area.x()) + box.rect.x() * sx;
+        const float y0 = float(area.y()) + box.rect.y() * sy;
+        const float x1 = x0 + box.rect.width() * sx;
+        const float y1 = y0 + box.rect.height() * sy;
+
+        quad(bv, x0, y0, x1, y0 + lw);
+        quad(bv, x0, y1 - lw, x1, y1);
+        quad(bv, x0, y0 + lw, x0 + lw, y1 - lw);
+        quad(bv, x1 - lw, y0 + lw, x1, y1 - lw);
+
+        // Label sits in the bottom-right corner, inside the box
+        qreal textW = 0;
+        qreal textH = 0;
+        for(const QChar ch : box.label) {
+            const Glyph glyph = m_glyphs.value(ch, m_glyphs.value(QChar(' ')));
+            textW += glyph.advance;
+            textH = std::max(textH, glyph.size.height());
+        }
+        qreal pen = x1 - LABEL_MARGIN - textW;
+        const qreal top = y1 - LABEL_MARGIN - textH;
+        for(const QChar ch : box.label) {
+            const Glyph glyph = m_glyphs.value(ch, m_glyphs.value(QChar(' ')));
+            texturedQuad(lv, QRectF(QPointF(pen, top), glyph.size), glyph.uv);
+            pen += glyph.advance;
+        }
+    }
+
+    // Collapse the unused tail of the buffers into degenerate triangles
+    while(bv < bvEnd)
+        (bv++)->set(0, 0);
+    while(lv < lvEnd)
+        (lv++)->set(0, 0, 0, 0);
+
+    node->boxes.markDirty(QSGNode::DirtyGeometry);
+    node->labels.markDirty(QSGNode::DirtyGeometry);
+    return node;
+}
@@ -0,0 +1,107 @@
+/*
+ * ObjectRecognition
+ *
+ * Copyright (C) 2025 José de Jesús Deloya Cruz
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// SPDX-License-Identifier: GPL-3.0-or-later
+// Project: ObjectRecognition
+// Copyright (C) 2025 José de Jesús Deloya Cruz
+
+#ifndef DETECTIONOVERLAY_H
+#define DETECTIONOVERLAY_H
+
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QQuickItem>
+#include <QRect>
+#include <QRectF>
+#include <QVariantList>
+
+#include <vector>
+
+/**
+ * @brief Draws every detection box and label with two scene graph nodes:
+ * one flat-colour geometry node for all box outlines and one textured node
+ * for all label glyphs, sampled from a glyph atlas built once per item.
+ * Boxes are mapped from origW/origH to contentRect in updatePaintNode(),
+ * on the render thread, reusing the vertex buffers between frames.
+ */
+class DetectionOverlay : public QQuickItem
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_PROPERTY(QVariantList detections READ detections WRITE setDetections NOTIFY detectionsChanged)
+    Q_PROPERTY(QRectF contentRect READ contentRect WRITE setContentRect NOTIFY contentRectChanged)
+    Q_PROPERTY(QColor boxColor READ boxColor WRITE setBoxColor NOTIFY boxColorChanged)
+    Q_PROPERTY(QColor labelColor READ labelColor WRITE setLabelColor NOTIFY labelColorChanged)
+    Q_PROPERTY(qreal lineWidth READ lineWidth WRITE setLineWidth NOTIFY lineWidthChanged)
+public:
+    explicit DetectionOverlay(QQuickItem *parent = nullptr);
+
+    QVariantList detections() const { return m_detections; }
+    void setDetections(const QVariantList &detections);
+
+    // Area the video is drawn in, in item coordinates. Empty uses the item.
+    QRectF contentRect() const { return m_contentRect; }
+    void setContentRect(const QRectF &rect);
+
+    QColor boxColor() const { return m_boxColor; }
+    void setBoxColor(const QColor &color);
+    QColor labelColor() const { return m_labelColor; }
+    void setLabelColor(const QColor &color);
+    qreal lineWidth() const { return m_lineWidth; }
+    void setLineWidth(qreal width);
+
+signals:
+    void detectionsChanged();
+    void contentRectChanged();
+    void boxColorChanged();
+    void labelColorChanged();
+    void lineWidthChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+
+private:
+    struct Box {
+        QRect rect;
+        QString label;
+        int origW = 0;
+        int origH = 0;
+    };
+
+    struct Glyph {
+        QRectF uv;          // normalized rect in the atlas
+        QSizeF size;        // pixels
+        qreal advance = 0;  // pixels
+    };
+
+    QVariantList m_detections;
+    std::vector<Box> m_boxes;
+    QRectF m_contentRect;
+    QColor m_boxColor = Qt::red;
+    QColor m_labelColor = Qt::green;
+    qreal m_lineWidth = 3.0;
+
+    QImage m_atlas;
+    QHash<QChar, Glyph> m_glyphs;
+    bool m_colorsDirty = true;
+
+    void buildGlyphAtlas();
+};
+
+#endif // DETECTIONOVERLAY_H